@@ -42,3 +42,5 @@ else
         endif
     endif
 endif
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -18,6 +18,7 @@
  * limitations under the License.
  */
 #include <cutils/log.h>
+#include <utils/Timers.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
 
@@ -112,6 +113,9 @@ C2D_STATUS (*LINK_c2dFillSurface) ( uint32 surface_id, uint32 fill_color,
 #define MAX_SURFACES (MAX_RGB_SURFACES + MAX_YUV_2_PLANE_SURFACES + MAX_YUV_3_PLANE_SURFACES + 1)
 #define NUM_SURFACE_TYPES 3      // RGB_SURFACE + YUV_SURFACE_2_PLANES + YUV_SURFACE_3_PLANES
 #define MAX_BLIT_OBJECT_COUNT 50 // Max. blit objects that can be passed per draw
+#define MAX_GPU_MAPPINGS 16      // GPU mappings of ION buffers kept across draws
+#define MAX_TEMP_BUFFERS 4       // Pooled buffers for C2D stride conversion
+#define TEMP_BUFFER_IDLE_MS 1000 // Pooled buffers idle for this long are freed
 
 enum {
     RGB_SURFACE,
@@ -124,6 +128,36 @@ enum eConversionType {
     CONVERT_TO_C2D_FORMAT
 };
 
+enum {
+    GPU_MAP_FREE,
+    GPU_MAP_VALID,
+    GPU_MAP_STALE   // Evicted or buffer unmapped, release after the draw
+};
+
+/* A GPU mapping kept across draws, keyed by the address the buffer is
+ * mapped at in this process with its offset and size. The fd cannot tell
+ * buffers apart, all ION dma-bufs share one anon inode on this kernel. A key
+ * is only reused after gralloc unmapped the buffer holding it, and the unmap
+ * listener marks the mapping stale before that.
+ */
+struct gpu_mapping {
+    int state;
+    int base;
+    int offset;
+    int size;
+    uint32 gpuaddr;
+    uint32 last_use;
+};
+
+/* A pooled temporary buffer. Buffers are only handed out for the duration
+ * of a single stretch, which always completes its draw before returning.
+ */
+struct temp_buffer {
+    alloc_data data;
+    bool in_use;
+    nsecs_t last_use;
+};
+
 enum eC2DFlags {
     FLAGS_PREMULTIPLIED_ALPHA  = 1<<0,
     FLAGS_YUV_DESTINATION      = 1<<1,
@@ -144,10 +178,13 @@ struct copybit_context_t {
     C2D_OBJECT_STR blit_list[MAX_BLIT_OBJECT_COUNT]; // Z-ordered list of blit objects
     C2D_DRIVER_INFO c2d_driver_info;
     void *libc2d2;
-    alloc_data temp_src_buffer;
-    alloc_data temp_dst_buffer;
+    temp_buffer temp_buffers[MAX_TEMP_BUFFERS]; // Size-classed temp buffer pool
     unsigned int dst[NUM_SURFACE_TYPES]; // dst surfaces
     unsigned int mapped_gpu_addr[MAX_SURFACES]; // GPU addresses mapped inside copybit
+    gpu_mapping gpu_map[MAX_GPU_MAPPINGS]; // LRU cache of GPU mappings
+    uint32 gpu_map_serial;
+    bool gpu_map_disabled;
+    pthread_mutex_t gpu_map_lock;
     int blit_rgb_count;         // Total RGB surfaces being blit
     int blit_yuv_2_plane_count; // Total 2 plane YUV surfaces being
     int blit_yuv_3_plane_count; // Total 3 plane YUV  surfaces being blit
@@ -211,6 +248,80 @@ struct copybit_module_t HAL_MODULE_INFO_SYM = {
 };
 
 
+/* Unmap a GPU address unless a cached mapping still owns it. C2D hands back
+ * the same address for a buffer that is already mapped, so a per-draw
+ * mapping and evicted cache entries can alias a live one.
+ * Called with gpu_map_lock held.
+ */
+static void gpu_unmap_addr(copybit_context_t* ctx, uint32 gpuaddr)
+{
+    bool owned = false;
+    for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+        if (ctx->gpu_map[i].state == GPU_MAP_VALID &&
+            ctx->gpu_map[i].gpuaddr == gpuaddr) {
+            owned = true;
+            break;
+        }
+    }
+    if (!owned)
+        LINK_c2dUnMapAddr((void*)gpuaddr);
+
+    for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+        if (ctx->gpu_map[i].state == GPU_MAP_STALE &&
+            ctx->gpu_map[i].gpuaddr == gpuaddr) {
+            ctx->gpu_map[i].state = GPU_MAP_FREE;
+        }
+    }
+}
+
+/* Release the per-draw mappings and the stale cache entries. Only safe
+ * once the draw using them has completed.
+ */
+static void release_gpu_mappings(copybit_context_t* ctx)
+{
+    pthread_mutex_lock(&ctx->gpu_map_lock);
+    for (int i = 0; i < MAX_SURFACES; i++) {
+        if (ctx->mapped_gpu_addr[i]) {
+            gpu_unmap_addr(ctx, ctx->mapped_gpu_addr[i]);
+            ctx->mapped_gpu_addr[i] = 0;
+        }
+    }
+    for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+        if (ctx->gpu_map[i].state == GPU_MAP_STALE)
+            gpu_unmap_addr(ctx, ctx->gpu_map[i].gpuaddr);
+    }
+    pthread_mutex_unlock(&ctx->gpu_map_lock);
+}
+
+/* Called by gralloc before a buffer is unmapped from this process. The GPU
+ * mapping keeps the memory alive, so it is released after the pending draw
+ * or right away when copybit is idle.
+ */
+static void gpu_map_unmap_listener(void* cookie, void* base, size_t size)
+{
+    copybit_context_t* ctx = (copybit_context_t*)cookie;
+    // Never block here: the buffer may be freed by copybit itself
+    bool idle = (pthread_mutex_trylock(&ctx->wait_cleanup_lock) == 0);
+    bool busy = idle && (ctx->wait_timestamp || ctx->blit_count);
+
+    pthread_mutex_lock(&ctx->gpu_map_lock);
+    for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+        gpu_mapping& map = ctx->gpu_map[i];
+        if (map.state == GPU_MAP_VALID && map.base == (int)base) {
+            map.state = GPU_MAP_STALE;
+            if (idle && !busy)
+                gpu_unmap_addr(ctx, map.gpuaddr);
+        }
+    }
+    pthread_mutex_unlock(&ctx->gpu_map_lock);
+
+    if (idle)
+        pthread_mutex_unlock(&ctx->wait_cleanup_lock);
+}
+
+static bool has_temp_buffers(copybit_context_t* ctx);
+static void trim_temp_buffers(copybit_context_t* ctx, nsecs_t idle_time);
+
 /* thread function which waits on the timeStamp and cleans up the surfaces */
 static void* c2d_wait_loop(void* ptr) {
     copybit_context_t* ctx = (copybit_context_t*)(ptr);
@@ -221,8 +332,28 @@ static void* c2d_wait_loop(void* ptr) {
     while(ctx->stop_thread == false) {
         pthread_mutex_lock(&ctx->wait_cleanup_lock);
         while(ctx->wait_timestamp == false && !ctx->stop_thread) {
-            pthread_cond_wait(&(ctx->wait_cleanup_cond),
-                              &(ctx->wait_cleanup_lock));
+            if (!has_temp_buffers(ctx)) {
+                pthread_cond_wait(&(ctx->wait_cleanup_cond),
+                                  &(ctx->wait_cleanup_lock));
+                continue;
+            }
+            // Give the pooled temp buffers back once copybit goes idle
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += TEMP_BUFFER_IDLE_MS / 1000;
+            ts.tv_nsec += (TEMP_BUFFER_IDLE_MS % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            if (pthread_cond_timedwait(&(ctx->wait_cleanup_cond),
+                                       &(ctx->wait_cleanup_lock),
+                                       &ts) == ETIMEDOUT) {
+                trim_temp_buffers(ctx, ms2ns(TEMP_BUFFER_IDLE_MS));
+                // Nothing is queued, so drop the mappings of freed buffers
+                if (ctx->blit_count == 0)
+                    release_gpu_mappings(ctx);
+            }
         }
         if(ctx->wait_timestamp) {
             if(LINK_c2dWaitTimestamp(ctx->time_stamp)) {
@@ -230,12 +361,7 @@ static void* c2d_wait_loop(void* ptr) {
             }
             ctx->wait_timestamp = false;
             // Unmap any mapped addresses.
-            for (int i = 0; i < MAX_SURFACES; i++) {
-                if (ctx->mapped_gpu_addr[i]) {
-                    LINK_c2dUnMapAddr( (void*)ctx->mapped_gpu_addr[i]);
-                    ctx->mapped_gpu_addr[i] = 0;
-                }
-            }
+            release_gpu_mappings(ctx);
             // Reset the counts after the draw.
             ctx->blit_rgb_count = 0;
             ctx->blit_yuv_2_plane_count = 0;
@@ -333,11 +459,58 @@ int c2diGetBpp(int32 colorformat)
     return c2dBpp;
 }
 
+/* Look up a cached GPU mapping. Called with gpu_map_lock held. */
+static uint32 gpu_map_find(copybit_context_t* ctx,
+                           const struct private_handle_t *handle)
+{
+    for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+        gpu_mapping& map = ctx->gpu_map[i];
+        if (map.state == GPU_MAP_VALID &&
+            map.base == handle->base && map.offset == handle->offset &&
+            map.size == handle->size) {
+            map.last_use = ++ctx->gpu_map_serial;
+            return map.gpuaddr;
+        }
+    }
+    return 0;
+}
+
+/* Cache a new GPU mapping. When the cache is full the least recently used
+ * entry is evicted and the new mapping is kept for this draw only, the
+ * slot frees up once the evicted mapping is released after the draw.
+ * Called with gpu_map_lock held.
+ */
+static bool gpu_map_insert(copybit_context_t* ctx,
+                           const struct private_handle_t *handle,
+                           uint32 gpuaddr)
+{
+    int lru = -1;
+    for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+        gpu_mapping& map = ctx->gpu_map[i];
+        if (map.state == GPU_MAP_FREE) {
+            map.state = GPU_MAP_VALID;
+            map.base = handle->base;
+            map.offset = handle->offset;
+            map.size = handle->size;
+            map.gpuaddr = gpuaddr;
+            map.last_use = ++ctx->gpu_map_serial;
+            return true;
+        }
+        if (map.state == GPU_MAP_VALID &&
+            (lru < 0 || (int32)(map.last_use - ctx->gpu_map[lru].last_use) < 0))
+            lru = i;
+    }
+    if (lru >= 0)
+        ctx->gpu_map[lru].state = GPU_MAP_STALE;
+    return false;
+}
+
 static uint32 c2d_get_gpuaddr(copybit_context_t* ctx, struct private_handle_t *handle,
                               int &mapped_idx)
 {
     uint32 memtype, *gpuaddr;
     C2D_STATUS rc;
+    bool cacheable = false;
 
     if(!handle)
         return 0;
@@ -354,10 +527,32 @@ static uint32 c2d_get_gpuaddr(copybit_context_t* ctx, struct private_handle_t *h
         return 0;
     }
 
+    // Only ION buffers are cached, gralloc tells us when they go away.
+    if (!ctx->gpu_map_disabled && memtype == KGSL_USER_MEM_TYPE_ION &&
+        handle->base) {
+        cacheable = true;
+    }
+
+    pthread_mutex_lock(&ctx->gpu_map_lock);
+    if (cacheable) {
+        uint32 cached = gpu_map_find(ctx, handle);
+        if (cached) {
+            pthread_mutex_unlock(&ctx->gpu_map_lock);
+            mapped_idx = -1;
+            return cached;
+        }
+    }
+
     rc = LINK_c2dMapAddr(handle->fd, (void*)handle->base, handle->size,
                                       handle->offset, memtype, (void**)&gpuaddr);
 
     if (rc == C2D_STATUS_OK) {
+        if (cacheable && gpu_map_insert(ctx, handle,
+                                        (uint32) gpuaddr)) {
+            pthread_mutex_unlock(&ctx->gpu_map_lock);
+            mapped_idx = -1;
+            return (uint32) gpuaddr;
+        }
         // We have mapped the GPU address inside copybit. We need to unmap this
         // address after the blit. Store this address
         for (int i = 0; i < MAX_SURFACES; i++) {
@@ -371,9 +566,11 @@ static uint32 c2d_get_gpuaddr(copybit_context_t* ctx, struct private_handle_t *h
                 break;
             }
         }
+        pthread_mutex_unlock(&ctx->gpu_map_lock);
 
         return (uint32) gpuaddr;
     }
+    pthread_mutex_unlock(&ctx->gpu_map_lock);
     return 0;
 }
 
@@ -382,10 +579,12 @@ static void unmap_gpuaddr(copybit_context_t* ctx, int mapped_idx)
     if (!ctx || (mapped_idx == -1))
         return;
 
+    pthread_mutex_lock(&ctx->gpu_map_lock);
     if (ctx->mapped_gpu_addr[mapped_idx]) {
-        LINK_c2dUnMapAddr( (void*)ctx->mapped_gpu_addr[mapped_idx]);
+        gpu_unmap_addr(ctx, ctx->mapped_gpu_addr[mapped_idx]);
         ctx->mapped_gpu_addr[mapped_idx] = 0;
     }
+    pthread_mutex_unlock(&ctx->gpu_map_lock);
 }
 
 static int is_supported_rgb_format(int format)
@@ -680,12 +879,7 @@ static int finish_copybit_internal(struct copybit_device_t *dev)
     }
 
     // Unmap any mapped addresses.
-    for (int i = 0; i < MAX_SURFACES; i++) {
-        if (ctx->mapped_gpu_addr[i]) {
-            LINK_c2dUnMapAddr( (void*)ctx->mapped_gpu_addr[i]);
-            ctx->mapped_gpu_addr[i] = 0;
-        }
-    }
+    release_gpu_mappings(ctx);
 
     // Reset the counts after the draw.
     ctx->blit_rgb_count = 0;
@@ -1022,18 +1216,30 @@ static size_t get_size(const bufferInfo& info)
     return size;
 }
 
+/* Round a temp buffer size up to its size class. Classes are an eighth of
+ * the next lower power of two apart, so slightly different frame sizes
+ * share pooled buffers while wasting less than an eighth of the size.
+ */
+static size_t get_size_class(size_t size)
+{
+    size_t step = 4096;
+    while ((step << 3) <= size)
+        step <<= 1;
+    return ALIGN(size, step);
+}
+
 /* Function to allocate memory for the temporary buffer. This memory is
  * allocated from Ashmem. It is the caller's responsibility to free this
  * memory.
  */
-static int get_temp_buffer(const bufferInfo& info, alloc_data& data)
+static int alloc_temp_buffer(size_t size, alloc_data& data)
 {
     ALOGD("%s E", __FUNCTION__);
     // Alloc memory from system heap
     data.base = 0;
     data.fd = -1;
     data.offset = 0;
-    data.size = get_size(info);
+    data.size = size;
     data.align = getpagesize();
     data.uncached = true;
     int allocFlags = GRALLOC_USAGE_PRIVATE_SYSTEM_HEAP;
@@ -1063,6 +1269,76 @@ static void free_temp_buffer(alloc_data &data)
     if (-1 != data.fd) {
         IMemAlloc* memalloc = sAlloc->getAllocator(data.allocType);
         memalloc->free_buffer(data.base, data.size, 0, data.fd);
+        data.fd = -1;
+        data.base = 0;
+        data.size = 0;
+    }
+}
+
+/* Get a temp buffer for the blit from the pool. A free buffer of the same
+ * size class is reused, otherwise an empty slot or the least recently used
+ * free buffer is (re)allocated.
+ */
+static alloc_data* get_temp_buffer(copybit_context_t* ctx,
+                                   const bufferInfo& info)
+{
+    size_t size = get_size_class(get_size(info));
+    temp_buffer* victim = NULL;
+    temp_buffer* buf = NULL;
+
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        temp_buffer& tmp = ctx->temp_buffers[i];
+        if (tmp.in_use)
+            continue;
+        if (tmp.data.fd != -1 && tmp.data.size == size) {
+            buf = &tmp;
+            break;
+        }
+        // Prefer empty slots, then the oldest buffer
+        if (!victim || (victim->data.fd != -1 &&
+                        (tmp.data.fd == -1 || tmp.last_use < victim->last_use)))
+            victim = &tmp;
+    }
+
+    if (!buf) {
+        if (!victim) {
+            ALOGE("%s: no free temp buffer slot", __FUNCTION__);
+            return NULL;
+        }
+        free_temp_buffer(victim->data);
+        if (alloc_temp_buffer(size, victim->data)) {
+            victim->data.fd = -1;
+            return NULL;
+        }
+        buf = victim;
+    }
+
+    buf->in_use = true;
+    buf->last_use = systemTime();
+    return &buf->data;
+}
+
+static bool has_temp_buffers(copybit_context_t* ctx)
+{
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        if (ctx->temp_buffers[i].data.fd != -1)
+            return true;
+    }
+    return false;
+}
+
+/* Free the pooled buffers that were not used for idle_time. Called with
+ * wait_cleanup_lock held, so no stretch is using them.
+ */
+static void trim_temp_buffers(copybit_context_t* ctx, nsecs_t idle_time)
+{
+    nsecs_t now = systemTime();
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        temp_buffer& tmp = ctx->temp_buffers[i];
+        if (tmp.data.fd != -1 && (now - tmp.last_use) >= idle_time) {
+            free_temp_buffer(tmp.data);
+            tmp.in_use = false;
+        }
     }
 }
 
@@ -1143,6 +1419,11 @@ static int stretch_copybit_internal(
         return -EINVAL;
     }
 
+    // Temp buffers of the previous stretch are done with, its draw has
+    // been executed before it returned.
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++)
+        ctx->temp_buffers[i].in_use = false;
+
     if (src->w > MAX_DIMENSION || src->h > MAX_DIMENSION) {
         ALOGE("%s: src dimension error", __FUNCTION__);
         return -EINVAL;
@@ -1215,20 +1496,18 @@ static int stretch_copybit_internal(
         return COPYBIT_FAILURE;
     }
     if (need_temp_dst) {
-        if (get_size(dst_info) != ctx->temp_dst_buffer.size) {
-            free_temp_buffer(ctx->temp_dst_buffer);
-            // Create a temp buffer and set that as the destination.
-            if (COPYBIT_FAILURE == get_temp_buffer(dst_info, ctx->temp_dst_buffer)) {
-                ALOGE("%s: get_temp_buffer(dst) failed", __FUNCTION__);
-                delete_handle(dst_hnd);
-                return COPYBIT_FAILURE;
-            }
+        // Get a temp buffer and set that as the destination.
+        alloc_data* temp_dst = get_temp_buffer(ctx, dst_info);
+        if (temp_dst == NULL) {
+            ALOGE("%s: get_temp_buffer(dst) failed", __FUNCTION__);
+            delete_handle(dst_hnd);
+            return COPYBIT_FAILURE;
         }
-        dst_hnd->fd = ctx->temp_dst_buffer.fd;
-        dst_hnd->size = ctx->temp_dst_buffer.size;
-        dst_hnd->flags = ctx->temp_dst_buffer.allocType;
-        dst_hnd->base = (int)(ctx->temp_dst_buffer.base);
-        dst_hnd->offset = ctx->temp_dst_buffer.offset;
+        dst_hnd->fd = temp_dst->fd;
+        dst_hnd->size = temp_dst->size;
+        dst_hnd->flags = temp_dst->allocType;
+        dst_hnd->base = (int)(temp_dst->base);
+        dst_hnd->offset = temp_dst->offset;
         dst_hnd->gpuaddr = 0;
         dst_image.handle = dst_hnd;
     }
@@ -1288,23 +1567,20 @@ static int stretch_copybit_internal(
         return COPYBIT_FAILURE;
     }
     if (need_temp_src) {
-        if (get_size(src_info) != ctx->temp_src_buffer.size) {
-            free_temp_buffer(ctx->temp_src_buffer);
-            // Create a temp buffer and set that as the destination.
-            if (COPYBIT_SUCCESS != get_temp_buffer(src_info,
-                                               ctx->temp_src_buffer)) {
-                ALOGE("%s: get_temp_buffer(src) failed", __FUNCTION__);
-                delete_handle(dst_hnd);
-                delete_handle(src_hnd);
-                unmap_gpuaddr(ctx, mapped_dst_idx);
-                return COPYBIT_FAILURE;
-            }
+        // Get a temp buffer and set that as the source.
+        alloc_data* temp_src = get_temp_buffer(ctx, src_info);
+        if (temp_src == NULL) {
+            ALOGE("%s: get_temp_buffer(src) failed", __FUNCTION__);
+            delete_handle(dst_hnd);
+            delete_handle(src_hnd);
+            unmap_gpuaddr(ctx, mapped_dst_idx);
+            return COPYBIT_FAILURE;
         }
-        src_hnd->fd = ctx->temp_src_buffer.fd;
-        src_hnd->size = ctx->temp_src_buffer.size;
-        src_hnd->flags = ctx->temp_src_buffer.allocType;
-        src_hnd->base = (int)(ctx->temp_src_buffer.base);
-        src_hnd->offset = ctx->temp_src_buffer.offset;
+        src_hnd->fd = temp_src->fd;
+        src_hnd->size = temp_src->size;
+        src_hnd->flags = temp_src->allocType;
+        src_hnd->base = (int)(temp_src->base);
+        src_hnd->offset = temp_src->offset;
         src_hnd->gpuaddr = 0;
         src_image.handle = src_hnd;
 
@@ -1483,6 +1759,15 @@ static void clean_up(copybit_context_t* ctx)
     pthread_mutex_destroy(&ctx->wait_cleanup_lock);
     pthread_cond_destroy (&ctx->wait_cleanup_cond);
 
+    // Drop the cached GPU mappings
+    if (LINK_c2dUnMapAddr) {
+        for (int i = 0; i < MAX_GPU_MAPPINGS; i++) {
+            if (ctx->gpu_map[i].state != GPU_MAP_FREE)
+                LINK_c2dUnMapAddr((void*)ctx->gpu_map[i].gpuaddr);
+        }
+    }
+    pthread_mutex_destroy(&ctx->gpu_map_lock);
+
     for (int i = 0; i < NUM_SURFACE_TYPES; i++) {
         if (ctx->dst[i])
             LINK_c2dDestroySurface(ctx->dst[i]);
@@ -1516,8 +1801,9 @@ static int close_copybit(struct hw_device_t *dev)
 {
     struct copybit_context_t* ctx = (struct copybit_context_t*)dev;
     if (ctx) {
-        free_temp_buffer(ctx->temp_src_buffer);
-        free_temp_buffer(ctx->temp_dst_buffer);
+        gralloc::removeUnmapListener(gpu_map_unmap_listener, ctx);
+        for (int i = 0; i < MAX_TEMP_BUFFERS; i++)
+            free_temp_buffer(ctx->temp_buffers[i].data);
     }
     clean_up(ctx);
     return 0;
@@ -1541,6 +1827,7 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
 
     /* initialize drawstate */
     memset(ctx, 0, sizeof(*ctx));
+    pthread_mutex_init(&(ctx->gpu_map_lock), NULL);
     ctx->libc2d2 = ::dlopen("libC2D2.so", RTLD_NOW);
     if (!ctx->libc2d2) {
         ALOGE("FATAL ERROR: could not dlopen libc2d2.so: %s", dlerror());
@@ -1749,13 +2036,12 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
     // Initialize context variables.
     ctx->trg_transform = C2D_TARGET_ROTATE_0;
 
-    ctx->temp_src_buffer.fd = -1;
-    ctx->temp_src_buffer.base = 0;
-    ctx->temp_src_buffer.size = 0;
-
-    ctx->temp_dst_buffer.fd = -1;
-    ctx->temp_dst_buffer.base = 0;
-    ctx->temp_dst_buffer.size = 0;
+    for (int i = 0; i < MAX_TEMP_BUFFERS; i++) {
+        ctx->temp_buffers[i].data.fd = -1;
+        ctx->temp_buffers[i].data.base = 0;
+        ctx->temp_buffers[i].data.size = 0;
+        ctx->temp_buffers[i].in_use = false;
+    }
 
     ctx->fb_width = 0;
     ctx->fb_height = 0;
@@ -1778,6 +2064,13 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
                                                             (void *)ctx);
     pthread_attr_destroy(&attr);
 
+    if (gralloc::addUnmapListener(gpu_map_unmap_listener, ctx)) {
+        // Without notifications a freed buffer could alias a cached mapping
+        ALOGW("%s: no unmap listener slot, GPU mapping cache disabled",
+              __FUNCTION__);
+        ctx->gpu_map_disabled = true;
+    }
+
     *device = &ctx->device.common;
     return status;
 }
@@ -28,10 +28,263 @@
  */
 
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/prctl.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "software_converter.h"
 
+void interleave_chroma_c(unsigned char* dst, const unsigned char* first,
+                         const unsigned char* second, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        *dst++ = *first++;
+        *dst++ = *second++;
+    }
+}
+
+#ifdef __ARM_HAVE_NEON
+void interleave_chroma_neon(unsigned char* dst, const unsigned char* first,
+                            const unsigned char* second, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __asm__ __volatile__ (
+                                "vld1.u8 {q0}, [%0]! \n"
+                                "vld1.u8 {q1}, [%1]! \n"
+                                "vst2.u8 {q0, q1}, [%2]! \n"
+                                :"+r"(first), "+r"(second), "+r"(dst)
+                                :
+                                :"memory","d0","d1","d2","d3"
+                             );
+    }
+    interleave_chroma_c(dst, first, second, count - i);
+}
+#endif
+
+#ifdef __SSE2__
+void interleave_chroma_sse2(unsigned char* dst, const unsigned char* first,
+                            const unsigned char* second, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)first);
+        __m128i b = _mm_loadu_si128((const __m128i*)second);
+        _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi8(a, b));
+        first += 16;
+        second += 16;
+        dst += 32;
+    }
+    interleave_chroma_c(dst, first, second, count - i);
+}
+#endif
+
+static inline void interleave_chroma(unsigned char* dst,
+                                     const unsigned char* first,
+                                     const unsigned char* second,
+                                     unsigned int count)
+{
+#if defined(__ARM_HAVE_NEON)
+    interleave_chroma_neon(dst, first, second, count);
+#elif defined(__SSE2__)
+    interleave_chroma_sse2(dst, first, second, count);
+#else
+    interleave_chroma_c(dst, first, second, count);
+#endif
+}
+
+/* Copy a plane between buffers of different strides */
+static void copy_plane(unsigned char* dst, int dst_stride,
+                       const unsigned char* src, int src_stride,
+                       int width, int height)
+{
+    if (height <= 0)
+        return;
+    if (src_stride == dst_stride) {
+        // Same layout, copy the padding along in one go
+        memcpy(dst, src, src_stride * (height - 1) + width);
+        return;
+    }
+    for (int i = 0; i < height; i++) {
+        memcpy(dst, src, width);
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+/* Frames of at least this many pixels are converted in parallel bands */
+#define PARALLEL_MIN_PIXELS (640 * 480)
+#define MAX_CONVERT_WORKERS 3
+
+/* Converts the rows [first, last) of a frame */
+typedef void (*band_func_t)(void* arg, int first, int last);
+
+/* Persistent pool of conversion workers. Worker n converts band n of each
+ * job, the calling thread converts band 0.
+ */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    int workers;
+    unsigned int generation;
+    int pending;
+    band_func_t func;
+    void* arg;
+    int rows;
+} sPool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+            PTHREAD_COND_INITIALIZER, 0, 0, 0, NULL, NULL, 0 };
+
+// Serializes jobs from multiple copybit instances
+static pthread_mutex_t sDispatchLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t sPoolOnce = PTHREAD_ONCE_INIT;
+
+/* Start row of a band, kept even so bands never split a chroma row */
+static int band_start(int band, int bands, int rows)
+{
+    if (band >= bands)
+        return rows;
+    return (rows * band / bands) & ~1;
+}
+
+static void* convert_worker(void* ptr)
+{
+    int band = (int)(intptr_t)ptr;
+    unsigned int generation = 0;
+    char thread_name[64] = "copybitConvert";
+    prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
+    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+
+    pthread_mutex_lock(&sPool.lock);
+    while (true) {
+        while (sPool.generation == generation)
+            pthread_cond_wait(&sPool.start_cond, &sPool.lock);
+        generation = sPool.generation;
+
+        band_func_t func = sPool.func;
+        void* arg = sPool.arg;
+        int bands = sPool.workers + 1;
+        int first = band_start(band, bands, sPool.rows);
+        int last = band_start(band + 1, bands, sPool.rows);
+        pthread_mutex_unlock(&sPool.lock);
+        if (first < last)
+            func(arg, first, last);
+        pthread_mutex_lock(&sPool.lock);
+
+        if (--sPool.pending == 0)
+            pthread_cond_signal(&sPool.done_cond);
+    }
+    return NULL;
+}
+
+static void start_workers()
+{
+    char property[PROPERTY_VALUE_MAX];
+    if (property_get("debug.copybit.mtconvert", property, "1") > 0 &&
+        atoi(property) == 0)
+        return;
+
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    int workers = (cpus > 1) ? (int)(cpus - 1) : 0;
+    if (workers > MAX_CONVERT_WORKERS)
+        workers = MAX_CONVERT_WORKERS;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, convert_worker,
+                           (void*)(intptr_t)(i + 1))) {
+            ALOGE("%s: failed to create worker %d", __FUNCTION__, i);
+            break;
+        }
+        sPool.workers++;
+    }
+    pthread_attr_destroy(&attr);
+    ALOGD("%s: %d conversion workers", __FUNCTION__, sPool.workers);
+}
+
+/* Run func over all rows of a frame, split in bands across the workers
+ * when the frame is large enough to be worth it.
+ */
+static void run_bands(band_func_t func, void* arg, int rows, int pixels)
+{
+    if (pixels >= PARALLEL_MIN_PIXELS)
+        pthread_once(&sPoolOnce, start_workers);
+
+    if (pixels < PARALLEL_MIN_PIXELS || sPool.workers == 0) {
+        func(arg, 0, rows);
+        return;
+    }
+
+    pthread_mutex_lock(&sDispatchLock);
+    pthread_mutex_lock(&sPool.lock);
+    sPool.func = func;
+    sPool.arg = arg;
+    sPool.rows = rows;
+    sPool.pending = sPool.workers;
+    sPool.generation++;
+    pthread_cond_broadcast(&sPool.start_cond);
+    pthread_mutex_unlock(&sPool.lock);
+
+    func(arg, 0, band_start(1, sPool.workers + 1, rows));
+
+    pthread_mutex_lock(&sPool.lock);
+    while (sPool.pending)
+        pthread_cond_wait(&sPool.done_cond, &sPool.lock);
+    pthread_mutex_unlock(&sPool.lock);
+    pthread_mutex_unlock(&sDispatchLock);
+}
+
+struct interleaveInfo {
+    unsigned char* src;
+    unsigned char* dst;
+    unsigned int stride;
+    unsigned int width;
+    unsigned int height;
+    unsigned int y_size;
+    unsigned int c_width;
+    unsigned int c_size;
+    unsigned int chromaPadding;
+};
+
+/* Convert the rows [first, last) of a YV12 frame to YCrCb_420_SP */
+static void convert_yv12_band(void* arg, int first, int last)
+{
+    interleaveInfo& info = *(interleaveInfo*)arg;
+    unsigned char* newChroma = info.dst + info.y_size;
+    unsigned char* oldChroma = info.src + info.y_size;
+
+    memcpy(info.dst + first * info.stride, info.src + first * info.stride,
+           (last - first) * info.stride);
+
+    // YV12 holds Cr then Cb, interleave them as CrCb. Without padding the
+    // planes are contiguous, otherwise go row by row and skip the padding.
+    if(!info.chromaPadding) {
+        unsigned int start = (first/2) * info.c_width;
+        unsigned int end = ((unsigned int)last == info.height) ?
+                info.c_size : (last/2) * info.c_width;
+        interleave_chroma(newChroma + start * 2, oldChroma + start,
+                          oldChroma + info.c_size + start, end - start);
+    } else {
+        unsigned int c_pairs = info.width/2;
+        for(unsigned int r = first/2; r < (unsigned int)last/2; r++) {
+            interleave_chroma(newChroma + r * c_pairs * 2,
+                              oldChroma + r * info.c_width,
+                              oldChroma + info.c_size + r * info.c_width,
+                              c_pairs);
+        }
+    }
+}
+
 /** Convert YV12 to YCrCb_420_SP */
 int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_handle)
 {
@@ -55,70 +308,18 @@ int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_h
     unsigned int   c_width = ALIGN(stride/2, 16);
     unsigned int   c_size  = c_width * src->h/2;
     unsigned int   chromaPadding = c_width - width/2;
-    unsigned int   chromaSize = c_size * 2;
-    unsigned char* newChroma = (unsigned char *)(yv12_handle->base + y_size);
-    unsigned char* oldChroma = (unsigned char*)(hnd->base + y_size);
-    memcpy((char *)yv12_handle->base,(char *)hnd->base,y_size);
-
-#ifdef __ARM_HAVE_NEON
-   /* interleave */
-    if(!chromaPadding) {
-        unsigned char * t1 = newChroma;
-        unsigned char * t2 = oldChroma;
-        unsigned char * t3 = t2 + chromaSize/2;
-        for(unsigned int i=0; i < (chromaSize/2)>>3; i++) {
-            __asm__ __volatile__ (
-                                    "vld1.u8 d0, [%0]! \n"
-                                    "vld1.u8 d1, [%1]! \n"
-                                    "vst2.u8 {d0, d1}, [%2]! \n"
-                                    :"+r"(t2), "+r"(t3), "+r"(t1)
-                                    :
-                                    :"memory","d0","d1"
-                                 );
 
-        }
-    }
-#else  //__ARM_HAVE_NEON
-    if(!chromaPadding) {
-        for(unsigned int i = 0; i< chromaSize/2; i++) {
-            newChroma[i*2]   = oldChroma[i];
-            newChroma[i*2+1] = oldChroma[i+chromaSize/2];
-        }
-
-    }
-#endif
-    // If the image is not aligned to 16 pixels,
-    // convert using the C routine below
-    // r1 tracks the row of the source buffer
-    // r2 tracks the row of the destination buffer
-    // The width/2 checks are to avoid copying
-    // from the padding
-
-    if(chromaPadding) {
-        unsigned int r1 = 0, r2 = 0, i = 0, j = 0;
-        while(r1 < height/2) {
-            if(j == width) {
-                j = 0;
-                r2++;
-                continue;
-            }
-            if (j+1 == width) {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                r2++;
-                newChroma[r2*width] = oldChroma[r1*c_width+i+c_size];
-                j = 1;
-            } else {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                newChroma[r2*width + j + 1] = oldChroma[r1*c_width+i+c_size];
-                j+=2;
-            }
-            i++;
-            if (i == width/2 ) {
-                i = 0;
-                r1++;
-            }
-        }
-    }
+    interleaveInfo info;
+    info.src = (unsigned char*)hnd->base;
+    info.dst = (unsigned char*)yv12_handle->base;
+    info.stride = stride;
+    info.width = width;
+    info.height = height;
+    info.y_size = y_size;
+    info.c_width = c_width;
+    info.c_size = c_size;
+    info.chromaPadding = chromaPadding;
+    run_bands(convert_yv12_band, &info, height, width * height);
 
   return 0;
 }
@@ -136,6 +337,34 @@ struct copyInfo{
     int dst_plane_offset;
 };
 
+struct copyJob {
+    unsigned char* src;
+    unsigned char* dst;
+    copyInfo* info;
+};
+
+/* Copy the luma rows [first, last) and the matching plane 1 rows */
+static void copy_band(void* arg, int first, int last)
+{
+    copyJob& job = *(copyJob*)arg;
+    copyInfo& info = *job.info;
+
+    // Copy the luma
+    copy_plane(job.dst + first * info.dst_stride, info.dst_stride,
+               job.src + first * info.src_stride, info.src_stride,
+               info.width, last - first);
+
+    // Copy plane 1
+    int plane_first = first * info.plane_height / info.height;
+    int plane_last = (last == info.height) ? info.plane_height :
+            last * info.plane_height / info.height;
+    copy_plane(job.dst + info.dst_plane_offset +
+               plane_first * info.dst_plane_stride, info.dst_plane_stride,
+               job.src + info.src_plane_offset +
+               plane_first * info.src_plane_stride, info.src_plane_stride,
+               info.plane_width, plane_last - plane_first);
+}
+
 /* Internal function to do the actual copy of source to destination */
 static int copy_source_to_destination(const int src_base, const int dst_base,
                                       copyInfo& info)
@@ -146,28 +375,14 @@ static int copy_source_to_destination(const int src_base, const int dst_base,
          return COPYBIT_FAILURE;
     }
 
-    int width = info.width;
-    int height = info.height;
-    unsigned char *src = (unsigned char*)src_base;
-    unsigned char *dst = (unsigned char*)dst_base;
+    if (info.height <= 0)
+        return 0;
 
-    // Copy the luma
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
-
-    // Copy plane 1
-    src = (unsigned char*)(src_base + info.src_plane_offset);
-    dst = (unsigned char*)(dst_base + info.dst_plane_offset);
-    width = info.plane_width;
-    height = info.plane_height;
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        src += info.src_plane_stride;
-        dst += info.dst_plane_stride;
-    }
+    copyJob job;
+    job.src = (unsigned char*)src_base;
+    job.dst = (unsigned char*)dst_base;
+    job.info = &info;
+    run_bands(copy_band, &job, info.height, info.width * info.height);
     return 0;
 }
 
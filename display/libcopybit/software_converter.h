@@ -38,6 +38,23 @@
 
 int convertYV12toYCrCb420SP(const copybit_image_t *src,private_handle_t *yv12_handle);
 
+/*
+ * Interleave two chroma planes into a pseudo planar one, i.e.
+ * dst[2i] = first[i] and dst[2i+1] = second[i]. The conversions use the
+ * fastest variant the build has, all of them are exported for the host
+ * test in test/.
+ */
+void interleave_chroma_c(unsigned char* dst, const unsigned char* first,
+                         const unsigned char* second, unsigned int count);
+#ifdef __ARM_HAVE_NEON
+void interleave_chroma_neon(unsigned char* dst, const unsigned char* first,
+                            const unsigned char* second, unsigned int count);
+#endif
+#ifdef __SSE2__
+void interleave_chroma_sse2(unsigned char* dst, const unsigned char* first,
+                            const unsigned char* second, unsigned int count);
+#endif
+
 /*
  * Function to convert the c2d format into an equivalent Android format
  *
@@ -0,0 +1,22 @@
+LOCAL_PATH := $(call my-dir)
+include $(LOCAL_PATH)/../../common.mk
+include $(CLEAR_VARS)
+
+# Host test and benchmark of software_converter.cpp, see
+# software_converter_test.cpp
+LOCAL_MODULE                  := copybit_convert_test
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_STATIC_LIBRARIES        := libcutils liblog
+LOCAL_LDLIBS                  := -lpthread -lrt
+# The target's NEON flag does not apply to the host
+LOCAL_CFLAGS                  := $(filter-out -D__ARM_HAVE_NEON,$(common_flags))
+LOCAL_CFLAGS                  += -DLOG_TAG=\"copybit_convert_test\"
+ifeq ($(HOST_ARCH),x86)
+    LOCAL_CFLAGS              += -msse2
+endif
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_SRC_FILES               := software_converter_test.cpp            \
+                                 ../software_converter.cpp
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test for software_converter.cpp. Checks every interleave_chroma
+ * variant the build has against a byte loop, for all tails up to two
+ * vectors and unaligned pointers, then converts YV12 frames with and
+ * without chroma padding, small and large enough for the parallel bands,
+ * and compares them with a reference conversion.
+ *
+ * usage: copybit_convert_test [-b]
+ *   -b  also report the throughput of every variant and of a 1080p
+ *       conversion
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "software_converter.h"
+
+typedef void (*interleave_func_t)(unsigned char* dst,
+        const unsigned char* first, const unsigned char* second,
+        unsigned int count);
+
+static const struct {
+    const char* name;
+    interleave_func_t func;
+} sVariants[] = {
+    { "c", interleave_chroma_c },
+#ifdef __ARM_HAVE_NEON
+    { "neon", interleave_chroma_neon },
+#endif
+#ifdef __SSE2__
+    { "sse2", interleave_chroma_sse2 },
+#endif
+};
+
+#define NUM_VARIANTS (sizeof(sVariants) / sizeof(sVariants[0]))
+#define GUARD 64
+
+static int sFailures = 0;
+
+/* private_handle_t::base is an int, keep buffers addressable by it */
+static unsigned char* allocBuffer(size_t size)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+    flags |= MAP_32BIT;
+#endif
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "mmap of %zu bytes failed\n", size);
+        exit(1);
+    }
+    return (unsigned char*)base;
+}
+
+static void freeBuffer(unsigned char* base, size_t size)
+{
+    munmap(base, size);
+}
+
+static void fill(unsigned char* buf, size_t size, unsigned int seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (unsigned char)(seed >> 16);
+    }
+}
+
+static void testInterleave()
+{
+    const unsigned int maxCount = 2 * 16 + 15;
+    unsigned char first[maxCount + 4], second[maxCount + 4];
+    unsigned char dst[2 * maxCount + 4 + GUARD];
+    unsigned char ref[2 * maxCount + 4 + GUARD];
+    fill(first, sizeof(first), 1);
+    fill(second, sizeof(second), 2);
+
+    for (size_t v = 0; v < NUM_VARIANTS; v++) {
+        for (unsigned int count = 0; count <= maxCount; count++) {
+            for (unsigned int align = 0; align < 4; align++) {
+                memset(dst, 0xA5, sizeof(dst));
+                memset(ref, 0xA5, sizeof(ref));
+                for (unsigned int i = 0; i < count; i++) {
+                    ref[align + 2 * i] = first[align + i];
+                    ref[align + 2 * i + 1] = second[align + i];
+                }
+                sVariants[v].func(dst + align, first + align,
+                                  second + align, count);
+                if (memcmp(dst, ref, sizeof(dst))) {
+                    printf("FAIL interleave_chroma_%s count %u align %u\n",
+                           sVariants[v].name, count, align);
+                    sFailures++;
+                }
+            }
+        }
+    }
+}
+
+/* YV12 to YCrCb_420_SP the way convertYV12toYCrCb420SP lays it out: the
+ * whole luma plane including its padding, then width/2 CrCb pairs per row
+ */
+static void referenceConvert(const unsigned char* src, unsigned char* dst,
+                             unsigned int stride, unsigned int width,
+                             unsigned int height)
+{
+    unsigned int y_size = stride * height;
+    unsigned int c_width = ALIGN(stride / 2, 16);
+    unsigned int c_size = c_width * height / 2;
+    memcpy(dst, src, y_size);
+    for (unsigned int r = 0; r < height / 2; r++) {
+        for (unsigned int i = 0; i < width / 2; i++) {
+            dst[y_size + r * width + 2 * i] = src[y_size + r * c_width + i];
+            dst[y_size + r * width + 2 * i + 1] =
+                    src[y_size + c_size + r * c_width + i];
+        }
+    }
+}
+
+static void testConvert(const char* name, unsigned int stride,
+                        unsigned int padding, unsigned int height)
+{
+    unsigned int width = stride - padding;
+    unsigned int c_width = ALIGN(stride / 2, 16);
+    size_t srcSize = stride * height + 2 * c_width * height / 2;
+    size_t dstSize = stride * height + width * height / 2 + GUARD;
+
+    unsigned char* src = allocBuffer(srcSize);
+    unsigned char* dst = allocBuffer(dstSize);
+    unsigned char* ref = allocBuffer(dstSize);
+    fill(src, srcSize, stride * height);
+    memset(dst, 0xA5, dstSize);
+    memset(ref, 0xA5, dstSize);
+    referenceConvert(src, ref, stride, width, height);
+
+    private_handle_t srcHnd(-1, srcSize, 0, BUFFER_TYPE_VIDEO,
+                            HAL_PIXEL_FORMAT_YV12, width, height);
+    private_handle_t dstHnd(-1, dstSize, 0, BUFFER_TYPE_VIDEO,
+                            HAL_PIXEL_FORMAT_YCrCb_420_SP, width, height);
+    srcHnd.base = (int)(intptr_t)src;
+    dstHnd.base = (int)(intptr_t)dst;
+    copybit_image_t image;
+    memset(&image, 0, sizeof(image));
+    image.w = stride;
+    image.h = height;
+    image.format = HAL_PIXEL_FORMAT_YV12;
+    image.base = src;
+    image.handle = &srcHnd;
+    image.horiz_padding = padding;
+
+    if (convertYV12toYCrCb420SP(&image, &dstHnd) ||
+            memcmp(dst, ref, dstSize)) {
+        printf("FAIL convert %s %ux%u stride %u\n", name, width, height,
+               stride);
+        sFailures++;
+    }
+    freeBuffer(src, srcSize);
+    freeBuffer(dst, dstSize);
+    freeBuffer(ref, dstSize);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void benchmark()
+{
+    //Chroma of a 1080p frame
+    const unsigned int count = 960 * 540;
+    const int iterations = 200;
+    unsigned char* first = allocBuffer(count);
+    unsigned char* second = allocBuffer(count);
+    unsigned char* dst = allocBuffer(2 * count);
+    fill(first, count, 1);
+    fill(second, count, 2);
+
+    for (size_t v = 0; v < NUM_VARIANTS; v++) {
+        double start = now();
+        for (int i = 0; i < iterations; i++)
+            sVariants[v].func(dst, first, second, count);
+        double secs = now() - start;
+        printf("interleave_chroma_%-5s %8.1f MB/s\n", sVariants[v].name,
+               2.0 * count * iterations / secs / (1024 * 1024));
+    }
+    freeBuffer(first, count);
+    freeBuffer(second, count);
+    freeBuffer(dst, 2 * count);
+
+    const unsigned int width = 1920, height = 1080;
+    size_t srcSize = width * height * 3 / 2;
+    unsigned char* src = allocBuffer(srcSize);
+    unsigned char* out = allocBuffer(srcSize);
+    fill(src, srcSize, 3);
+    private_handle_t srcHnd(-1, srcSize, 0, BUFFER_TYPE_VIDEO,
+                            HAL_PIXEL_FORMAT_YV12, width, height);
+    private_handle_t dstHnd(-1, srcSize, 0, BUFFER_TYPE_VIDEO,
+                            HAL_PIXEL_FORMAT_YCrCb_420_SP, width, height);
+    srcHnd.base = (int)(intptr_t)src;
+    dstHnd.base = (int)(intptr_t)out;
+    copybit_image_t image;
+    memset(&image, 0, sizeof(image));
+    image.w = width;
+    image.h = height;
+    image.format = HAL_PIXEL_FORMAT_YV12;
+    image.base = src;
+    image.handle = &srcHnd;
+
+    const int frames = 100;
+    double start = now();
+    for (int i = 0; i < frames; i++)
+        convertYV12toYCrCb420SP(&image, &dstHnd);
+    double secs = now() - start;
+    printf("convertYV12toYCrCb420SP 1080p %8.1f frames/s\n", frames / secs);
+    freeBuffer(src, srcSize);
+    freeBuffer(out, srcSize);
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b")) != -1) {
+        if (opt != 'b') {
+            fprintf(stderr, "usage: %s [-b]\n", argv[0]);
+            return 1;
+        }
+        bench = true;
+    }
+
+    testInterleave();
+    //Chroma rows are exactly c_width wide, interleaved in one go
+    testConvert("unpadded", 320, 0, 240);
+    testConvert("unpadded", 1280, 0, 720);
+    //Chroma rows padded up to 16, interleaved row by row with a tail
+    testConvert("padded", 352, 8, 240);
+    testConvert("padded", 1280, 8, 720);
+    //Odd number of pairs per row
+    testConvert("odd tail", 360, 2, 240);
+    testConvert("odd tail", 1296, 2, 720);
+
+    if (sFailures) {
+        printf("%d failures\n", sFailures);
+        return 1;
+    }
+    printf("all passed\n");
+    if (bench)
+        benchmark();
+    return 0;
+}
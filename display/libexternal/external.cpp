@@ -44,6 +44,8 @@ namespace qhwc {
 
 #define MAX_FRAME_BUFFER_NAME_SIZE      (80)
 #define MAX_DISPLAY_DEVICES             (3)
+// Frames without video before HDMI goes back from a video refresh rate
+#define NO_VIDEO_FRAMES_TO_RESTORE      (60)
 
 
 const char* msmFbDevicePath[] = {  "/dev/graphics/fb1",
@@ -125,8 +127,12 @@ int ExternalDisplay::configureWFDDisplay() {
 int ExternalDisplay::teardownHDMIDisplay() {
     if(mConnectedFbNum == mHdmiFbNum) {
         // hdmi offline event..!
-        closeFrameBuffer();
-        resetInfo();
+        {
+            // prepare may be looking at the mode for a refresh rate switch
+            Mutex::Autolock lock(mExtDispLock);
+            closeFrameBuffer();
+            resetInfo();
+        }
         setExternalDisplay(false);
     }
     return 0;
@@ -167,11 +173,16 @@ void ExternalDisplay::processUEventOffline(const char *str) {
 }
 
 ExternalDisplay::ExternalDisplay(hwc_context_t* ctx):mFd(-1),
-    mCurrentMode(-1), mConnected(0), mConnectedFbNum(0), mModeCount(0),
+    mCurrentMode(-1), mPendingMode(-1), mConnected(0), mConnectedFbNum(0), mModeCount(0),
+    mEDIDModeCount(0), mContentFps(0), mNoVideoFrames(0), mMatchFps(false),
     mUnderscanSupported(false), mHwcContext(ctx), mHdmiFbNum(-1),
     mWfdFbNum(-1), mExtDpyNum(HWC_DISPLAY_EXTERNAL)
 {
     memset(&mVInfo, 0, sizeof(mVInfo));
+    memset(mEDIDs, 0, sizeof(mEDIDs));
+    char property[PROPERTY_VALUE_MAX];
+    if(property_get("hw.hdmi.match_fps", property, "0") > 0)
+        mMatchFps = (atoi(property) == 1);
     //Determine the fb index for external display devices.
     updateExtDispDevFbIndex();
     // disable HPD at start, it will be enabled later
@@ -380,6 +391,64 @@ static struct disp_mode_timing_type supported_video_mode_lut[] = {
     {m1920x1080p30_16_9, 1920, 1080,  88,  44, 148,  4, 5, 36,  74250, false},
 };
 
+// Active size and refresh rate of a progressive mode
+static void getModeAttr(int mode, int& width, int& height, int& fps) {
+    switch (mode) {
+        case m640x480p60_4_3:
+            width = 640;
+            height = 480;
+            fps = 60;
+            break;
+        case m720x480p60_4_3:
+        case m720x480p60_16_9:
+            width = 720;
+            height = 480;
+            fps = 60;
+            break;
+        case m720x576p50_4_3:
+        case m720x576p50_16_9:
+            width = 720;
+            height = 576;
+            fps = 50;
+            break;
+        case m1280x720p50_16_9:
+            width = 1280;
+            height = 720;
+            fps = 50;
+            break;
+        case m1280x720p60_16_9:
+            width = 1280;
+            height = 720;
+            fps = 60;
+            break;
+        case m1920x1080p24_16_9:
+            width = 1920;
+            height = 1080;
+            fps = 24;
+            break;
+        case m1920x1080p25_16_9:
+            width = 1920;
+            height = 1080;
+            fps = 25;
+            break;
+        case m1920x1080p30_16_9:
+            width = 1920;
+            height = 1080;
+            fps = 30;
+            break;
+        case m1920x1080p50_16_9:
+            width = 1920;
+            height = 1080;
+            fps = 50;
+            break;
+        case m1920x1080p60_16_9:
+            width = 1920;
+            height = 1080;
+            fps = 60;
+            break;
+    }
+}
+
 int ExternalDisplay::parseResolution(char* edidStr, int* edidModes)
 {
     char delim = ',';
@@ -404,39 +473,48 @@ int ExternalDisplay::parseResolution(char* edidStr, int* edidModes)
 bool ExternalDisplay::readResolution()
 {
     char sysFsEDIDFilePath[255];
+    char edids[sizeof(mEDIDs)];
     sprintf(sysFsEDIDFilePath , "/sys/devices/virtual/graphics/fb%d/edid_modes",
             mHdmiFbNum);
 
     int hdmiEDIDFile = open(sysFsEDIDFilePath, O_RDONLY, 0);
     int len = -1;
 
+    memset(edids, 0, sizeof(edids));
     if (hdmiEDIDFile < 0) {
         ALOGE("%s: edid_modes file '%s' not found",
                  __FUNCTION__, sysFsEDIDFilePath);
         return false;
     } else {
-        len = read(hdmiEDIDFile, mEDIDs, sizeof(mEDIDs)-1);
+        len = read(hdmiEDIDFile, edids, sizeof(edids)-1);
         ALOGD_IF(DEBUG, "%s: EDID string: %s length = %d",
-                 __FUNCTION__, mEDIDs, len);
+                 __FUNCTION__, edids, len);
         if ( len <= 0) {
             ALOGE("%s: edid_modes file empty '%s'",
                      __FUNCTION__, sysFsEDIDFilePath);
         }
         else {
-            while (len > 1 && isspace(mEDIDs[len-1]))
+            while (len > 1 && isspace(edids[len-1]))
                 --len;
-            mEDIDs[len] = 0;
+            edids[len] = 0;
         }
     }
     close(hdmiEDIDFile);
     if(len > 0) {
-        // Get EDID modes from the EDID strings
-        mModeCount = parseResolution(mEDIDs, mEDIDModes);
+        Mutex::Autolock lock(mExtDispLock);
+        // Reparse only when the sink reports a different mode list,
+        // a reseat of the same TV reuses the modes parsed last time.
+        if(!mEDIDModeCount || strcmp(edids, mEDIDs)) {
+            memcpy(mEDIDs, edids, sizeof(mEDIDs));
+            // Get EDID modes from the EDID strings
+            mEDIDModeCount = parseResolution(mEDIDs, mEDIDModes);
+        }
+        mModeCount = mEDIDModeCount;
         ALOGD_IF(DEBUG, "%s: mModeCount = %d", __FUNCTION__,
                  mModeCount);
     }
 
-    return (strlen(mEDIDs) > 0);
+    return (len > 0);
 }
 
 bool ExternalDisplay::openFrameBuffer(int fbNum)
@@ -466,14 +544,16 @@ bool ExternalDisplay::closeFrameBuffer()
     return (ret == 0);
 }
 
-// clears the vinfo, edid, best modes
+// clears the vinfo and best modes
 void ExternalDisplay::resetInfo()
 {
     memset(&mVInfo, 0, sizeof(mVInfo));
-    memset(mEDIDs, 0, sizeof(mEDIDs));
-    memset(mEDIDModes, 0, sizeof(mEDIDModes));
+    // mEDIDs and the modes parsed from it stay cached for the next connect
     mModeCount = 0;
     mCurrentMode = -1;
+    mPendingMode = -1;
+    mContentFps = 0;
+    mNoVideoFrames = 0;
     mUnderscanSupported = false;
     // Reset the underscan supported system property
     const char* prop = "0";
@@ -541,6 +621,28 @@ int ExternalDisplay::getUserMode() {
     return -1;
 }
 
+// Scores a mode for the video frame rate, higher is better, -1 if
+// unusable. A multiple of the frame rate plays without judder, otherwise
+// 60Hz is best for UI. The mode order breaks ties.
+int ExternalDisplay::getModeScore(int mode, int contentFps)
+{
+    int width = 0, height = 0, fps = 0;
+    int order = getModeOrder(mode);
+    getModeAttr(mode, width, height, fps);
+    if(order < 0 || !fps || isInterlacedMode(mode))
+        return -1;
+
+    int fpsScore = 0;
+    if(contentFps > 0 && fps % contentFps == 0) {
+        fpsScore = 4;
+    } else if(fps >= 60) {
+        fpsScore = contentFps > 0 ? 1 : 4;
+    } else if(fps >= 50 && contentFps <= 0) {
+        fpsScore = 2;
+    }
+    return fpsScore * 100 + order;
+}
+
 // Get the best mode for the current HD TV
 int ExternalDisplay::getBestMode() {
     int bestOrder = 0;
@@ -558,6 +660,82 @@ int ExternalDisplay::getBestMode() {
     return bestMode;
 }
 
+// Get the mode of the current resolution whose refresh rate suits the
+// content best, so that a rate switch never changes the display size.
+int ExternalDisplay::getBestRateMode(int contentFps) {
+    int bestScore = -1;
+    int curWidth = 0, curHeight = 0, curFps = 0;
+    Mutex::Autolock lock(mExtDispLock);
+    int bestMode = mCurrentMode;
+    getModeAttr(mCurrentMode, curWidth, curHeight, curFps);
+    for(int i = 0; i < mModeCount; i++) {
+        int mode = mEDIDModes[i];
+        int width = 0, height = 0, fps = 0;
+        getModeAttr(mode, width, height, fps);
+        if(width != curWidth || height != curHeight)
+            continue;
+        int score = getModeScore(mode, contentFps);
+        if (score > bestScore) {
+            bestScore = score;
+            bestMode = mode;
+        }
+    }
+    ALOGD_IF(DEBUG, "%s: contentFps = %d bestMode = %d", __FUNCTION__,
+             contentFps, bestMode);
+    return bestMode;
+}
+
+void ExternalDisplay::setContentFps(int fps)
+{
+    if(!mMatchFps)
+        return;
+    {
+        Mutex::Autolock lock(mExtDispLock);
+        if(!mConnected || mConnectedFbNum != mHdmiFbNum || mCurrentMode < 0)
+            return;
+        // Video can be gone for a few frames between clips, only go back to
+        // the UI rate once it has stayed away.
+        if(fps <= 0 && mContentFps > 0 &&
+                ++mNoVideoFrames < NO_VIDEO_FRAMES_TO_RESTORE)
+            return;
+        mNoVideoFrames = 0;
+        if(fps == mContentFps)
+            return;
+        mContentFps = fps;
+    }
+    // A mode forced thru adb shell is left alone
+    if(getUserMode() != -1)
+        return;
+    int mode = getBestRateMode(fps);
+    Mutex::Autolock lock(mExtDispLock);
+    if(mConnected && mode != mCurrentMode) {
+        ALOGD("%s: content at %dfps, switching to mode %d", __FUNCTION__,
+              fps, mode);
+        // The switch is applied once this frame is out, compose it on the
+        // FB only so that no other pipes are staged on HDMI meanwhile
+        mPendingMode = mode;
+        mHwcContext->mExtDispConfiguring = true;
+    }
+}
+
+void ExternalDisplay::applyPendingMode()
+{
+    int mode = -1;
+    {
+        Mutex::Autolock lock(mExtDispLock);
+        mode = mPendingMode;
+        mPendingMode = -1;
+        if(mode < 0 || !mConnected || mConnectedFbNum != mHdmiFbNum)
+            return;
+    }
+    setEDIDMode(mode);
+    setDpyHdmiAttr();
+    mHwcContext->mExtDispConfiguring = false;
+    // Redraw to bring the overlay pipes back on the new mode
+    if(mHwcContext->proc)
+        mHwcContext->proc->invalidate(mHwcContext->proc);
+}
+
 inline bool ExternalDisplay::isValidMode(int ID)
 {
     bool valid = false;
@@ -713,60 +891,7 @@ void ExternalDisplay::setDpyHdmiAttr() {
 }
 
 void ExternalDisplay::getAttrForMode(int& width, int& height, int& fps) {
-    switch (mCurrentMode) {
-        case m640x480p60_4_3:
-            width = 640;
-            height = 480;
-            fps = 60;
-            break;
-        case m720x480p60_4_3:
-        case m720x480p60_16_9:
-            width = 720;
-            height = 480;
-            fps = 60;
-            break;
-        case m720x576p50_4_3:
-        case m720x576p50_16_9:
-            width = 720;
-            height = 576;
-            fps = 50;
-            break;
-        case m1280x720p50_16_9:
-            width = 1280;
-            height = 720;
-            fps = 50;
-            break;
-        case m1280x720p60_16_9:
-            width = 1280;
-            height = 720;
-            fps = 60;
-            break;
-        case m1920x1080p24_16_9:
-            width = 1920;
-            height = 1080;
-            fps = 24;
-            break;
-        case m1920x1080p25_16_9:
-            width = 1920;
-            height = 1080;
-            fps = 25;
-            break;
-        case m1920x1080p30_16_9:
-            width = 1920;
-            height = 1080;
-            fps = 30;
-            break;
-        case m1920x1080p50_16_9:
-            width = 1920;
-            height = 1080;
-            fps = 50;
-            break;
-        case m1920x1080p60_16_9:
-            width = 1920;
-            height = 1080;
-            fps = 60;
-            break;
-    }
+    getModeAttr(mCurrentMode, width, height, fps);
 }
 
 };
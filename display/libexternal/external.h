@@ -46,12 +46,20 @@ public:
     bool isCEUnderscanSupported() { return mUnderscanSupported; }
     void setExternalDisplay(bool connected, int extFbNum = 0);
     bool isExternalConnected() { return mConnected;};
+    int getHdmiFbNum() const { return mHdmiFbNum; }
     void  setExtDpyNum(int extDpyNum) { mExtDpyNum = extDpyNum;};
     void setHPD(uint32_t startEnd);
     void setEDIDMode(int resMode);
     void setActionSafeDimension(int w, int h);
     void processUEventOnline(const char *str);
     void processUEventOffline(const char *str);
+    // Frame rate of the video being shown, 0 if none. Queues a switch of
+    // HDMI to a mode with a matching refresh rate when hw.hdmi.match_fps
+    // is set.
+    void setContentFps(int fps);
+    // Applies a switch queued by setContentFps, called after the frame
+    // is committed
+    void applyPendingMode();
 
 private:
     void readCEUnderscanInfo();
@@ -64,8 +72,10 @@ private:
     bool isValidMode(int ID);
     void handleUEvent(char* str, int len);
     int  getModeOrder(int mode);
+    int  getModeScore(int mode, int contentFps);
     int  getUserMode();
     int  getBestMode();
+    int  getBestRateMode(int contentFps);
     bool isInterlacedMode(int mode);
     void resetInfo();
     void setDpyHdmiAttr();
@@ -81,12 +91,21 @@ private:
     mutable android::Mutex mExtDispLock;
     int mFd;
     int mCurrentMode;
+    // Mode queued by setContentFps, -1 if none
+    int mPendingMode;
     int mConnected;
     int mConnectedFbNum;
     int mResolutionMode;
     char mEDIDs[128];
     int mEDIDModes[64];
     int mModeCount;
+    // Modes parsed from mEDIDs, kept across hotplugs of the same sink
+    int mEDIDModeCount;
+    // Video frame rate the current mode was picked for and the number of
+    // frames seen since the video went away
+    int mContentFps;
+    int mNoVideoFrames;
+    bool mMatchFps;
     bool mUnderscanSupported;
     hwc_context_t *mHwcContext;
     fb_var_screeninfo mVInfo;
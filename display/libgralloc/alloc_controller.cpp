@@ -30,6 +30,7 @@
 #include <cutils/log.h>
 #include <fcntl.h>
 #include <dlfcn.h>
+#include <pthread.h>
 #include "gralloc_priv.h"
 #include "alloc_controller.h"
 #include "memalloc.h"
@@ -170,6 +171,54 @@ IAllocController* IAllocController::getInstance(void)
 }
 
 
+//-------------- Unmap listeners-----------------------//
+#define MAX_UNMAP_LISTENERS 4
+
+static struct {
+    unmap_listener_t listener;
+    void* cookie;
+} sUnmapListeners[MAX_UNMAP_LISTENERS];
+static pthread_mutex_t sUnmapLock = PTHREAD_MUTEX_INITIALIZER;
+
+int gralloc::addUnmapListener(unmap_listener_t listener, void* cookie)
+{
+    int err = -ENOMEM;
+    pthread_mutex_lock(&sUnmapLock);
+    for (int i = 0; i < MAX_UNMAP_LISTENERS; i++) {
+        if (sUnmapListeners[i].listener == NULL) {
+            sUnmapListeners[i].listener = listener;
+            sUnmapListeners[i].cookie = cookie;
+            err = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sUnmapLock);
+    return err;
+}
+
+void gralloc::removeUnmapListener(unmap_listener_t listener, void* cookie)
+{
+    pthread_mutex_lock(&sUnmapLock);
+    for (int i = 0; i < MAX_UNMAP_LISTENERS; i++) {
+        if (sUnmapListeners[i].listener == listener &&
+            sUnmapListeners[i].cookie == cookie) {
+            sUnmapListeners[i].listener = NULL;
+            sUnmapListeners[i].cookie = NULL;
+        }
+    }
+    pthread_mutex_unlock(&sUnmapLock);
+}
+
+void gralloc::notifyUnmap(void* base, size_t size)
+{
+    pthread_mutex_lock(&sUnmapLock);
+    for (int i = 0; i < MAX_UNMAP_LISTENERS; i++) {
+        if (sUnmapListeners[i].listener)
+            sUnmapListeners[i].listener(sUnmapListeners[i].cookie, base, size);
+    }
+    pthread_mutex_unlock(&sUnmapLock);
+}
+
 //-------------- IonController-----------------------//
 IonController::IonController()
 {
@@ -212,6 +261,16 @@ int IonController::allocate(alloc_data& data, int usage)
     if(usage & GRALLOC_USAGE_PROTECTED)
          data.allocType |= private_handle_t::PRIV_FLAGS_SECURE_BUFFER;
 
+    // Buffers only hardware blocks access are mapped on the first
+    // gralloc_lock(). Composer and framebuffer buffers keep their mapping
+    // as copybit and the framebuffer post use the CPU address.
+    if(!(usage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) &&
+       (usage & GRALLOC_USAGE_HW_MASK) &&
+       !(usage & (GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_FB |
+                  GRALLOC_USAGE_HW_2D))) {
+        data.allocType |= private_handle_t::PRIV_FLAGS_NOT_MAPPED;
+    }
+
     // if no flags are set, default to
     // SF + IOMMU heaps, so that bypass can work
     // we can fall back to system heap if
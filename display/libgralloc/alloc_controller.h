@@ -29,6 +29,8 @@
 #ifndef GRALLOC_ALLOCCONTROLLER_H
 #define GRALLOC_ALLOCCONTROLLER_H
 
+#include <stddef.h>
+
 namespace gralloc {
 
 struct alloc_data;
@@ -67,5 +69,18 @@ class IonController : public IAllocController {
     IonAlloc* mIonAlloc;
 
 };
+
+// Listeners are told when a buffer is about to be unmapped from this
+// process, i.e. when gralloc frees or unregisters it. Modules that cache
+// per-buffer state keyed on the mapping (copybit GPU mappings) use this
+// to drop that state before the address can be reused.
+typedef void (*unmap_listener_t)(void* cookie, void* base, size_t size);
+
+int addUnmapListener(unmap_listener_t listener, void* cookie);
+
+void removeUnmapListener(unmap_listener_t listener, void* cookie);
+
+void notifyUnmap(void* base, size_t size);
+
 } //end namespace gralloc
 #endif // GRALLOC_ALLOCCONTROLLER_H
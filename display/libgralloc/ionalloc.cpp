@@ -33,14 +33,31 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <errno.h>
 #include "gralloc_priv.h"
 #include "ionalloc.h"
+#include "alloc_controller.h"
 
 using gralloc::IonAlloc;
 
 #define ION_DEVICE "/dev/ion"
 
+// Heaps backed by the page allocator. Their pages are expected to come
+// cleared from the kernel, which has not been verified for every ION
+// version, so the clear is only skipped when debug.gralloc.ion_zeroed is
+// set.
+#define ION_ZEROED_HEAPS (ION_HEAP(ION_SYSTEM_HEAP_ID) | \
+                          ION_HEAP(ION_IOMMU_HEAP_ID))
+
+IonAlloc::IonAlloc() : mIonFd(FD_INIT), mTrustZeroedHeaps(false)
+{
+    char property[PROPERTY_VALUE_MAX];
+    if (property_get("debug.gralloc.ion_zeroed", property, NULL) > 0 &&
+        atoi(property) == 1)
+        mTrustZeroedHeaps = true;
+}
+
 int IonAlloc::open_device()
 {
     if(mIonFd == FD_INIT)
@@ -65,6 +82,7 @@ void IonAlloc::close_device()
 int IonAlloc::alloc_buffer(alloc_data& data)
 {
     Locker::Autolock _l(mLock);
+    bool notMapped = data.allocType & private_handle_t::PRIV_FLAGS_NOT_MAPPED;
     int err = 0;
     struct ion_handle_data handle_data;
     struct ion_fd_data fd_data;
@@ -99,7 +117,11 @@ int IonAlloc::alloc_buffer(alloc_data& data)
         return err;
     }
 
-    if(!(data.flags & ION_SECURE)) {
+    // Hardware only buffers from heaps the kernel clears are not touched
+    // at all, gralloc_lock() maps them if software ever needs them.
+    bool zeroed = mTrustZeroedHeaps && notMapped &&
+            !(ionAllocData.heap_mask & ~ION_ZEROED_HEAPS);
+    if(!(data.flags & ION_SECURE) && !zeroed) {
         base = mmap(0, ionAllocData.len, PROT_READ|PROT_WRITE,
                     MAP_SHARED, fd_data.fd, 0);
         if(base == MAP_FAILED) {
@@ -113,6 +135,10 @@ int IonAlloc::alloc_buffer(alloc_data& data)
         // Clean cache after memset
         clean_buffer(base, data.size, data.offset, fd_data.fd,
                      CACHE_CLEAN_AND_INVALIDATE);
+        if (notMapped) {
+            unmap_buffer(base, ionAllocData.len, 0);
+            base = 0;
+        }
     }
 
     data.base = base;
@@ -168,6 +194,9 @@ int IonAlloc::unmap_buffer(void *base, size_t size, int offset)
 {
     ALOGD_IF(DEBUG, "ion: Unmapping buffer  base:%p size:%d", base, size);
     int err = 0;
+    // Let caches keyed on this mapping drop it while the address is
+    // still ours
+    gralloc::notifyUnmap(base, size);
     if(munmap(base, size)) {
         err = -errno;
         ALOGE("ion: Failed to unmap memory at %p : %s",
@@ -53,13 +53,16 @@ class IonAlloc : public IMemAlloc  {
     virtual int clean_buffer(void*base, size_t size,
                              int offset, int fd, int op);
 
-    IonAlloc() { mIonFd = FD_INIT; }
+    IonAlloc();
 
     ~IonAlloc() { close_device(); }
 
     private:
     int mIonFd;
 
+    // Skip clearing hardware only buffers from ION_ZEROED_HEAPS
+    bool mTrustZeroedHeaps;
+
     int open_device();
 
     void close_device();
@@ -34,6 +34,7 @@
 
 #include <hardware/hardware.h>
 #include <hardware/gralloc.h>
+#include <utils/KeyedVector.h>
 
 #include "gralloc_priv.h"
 #include "gr.h"
@@ -55,7 +56,7 @@ static IMemAlloc* getAllocator(int flags)
 }
 
 static int gralloc_map(gralloc_module_t const* module,
-                       buffer_handle_t handle)
+                       buffer_handle_t handle, bool lazy = false)
 {
     private_handle_t* hnd = (private_handle_t*)handle;
     void *mappedAddress;
@@ -63,16 +64,23 @@ static int gralloc_map(gralloc_module_t const* module,
         !(hnd->flags & private_handle_t::PRIV_FLAGS_SECURE_BUFFER)) {
         size_t size = hnd->size;
         IMemAlloc* memalloc = getAllocator(hnd->flags) ;
-        int err = memalloc->map_buffer(&mappedAddress, size,
+        int err = 0;
+        // On import, hardware only buffers wait for their first lock
+        if (hnd->base == 0 && (!lazy ||
+            !(hnd->flags & private_handle_t::PRIV_FLAGS_NOT_MAPPED))) {
+            err = memalloc->map_buffer(&mappedAddress, size,
                                        hnd->offset, hnd->fd);
-        if(err || mappedAddress == MAP_FAILED) {
-            ALOGE("Could not mmap handle %p, fd=%d (%s)",
-                  handle, hnd->fd, strerror(errno));
-            hnd->base = 0;
-            return -errno;
+            if(err || mappedAddress == MAP_FAILED) {
+                ALOGE("Could not mmap handle %p, fd=%d (%s)",
+                      handle, hnd->fd, strerror(errno));
+                hnd->base = 0;
+                return -errno;
+            }
+            hnd->base = intptr_t(mappedAddress) + hnd->offset;
         }
 
-        hnd->base = intptr_t(mappedAddress) + hnd->offset;
+        if (hnd->base_metadata != 0)
+            return 0;
         mappedAddress = MAP_FAILED;
         size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
         err = memalloc->map_buffer(&mappedAddress, size,
@@ -98,15 +106,20 @@ static int gralloc_unmap(gralloc_module_t const* module,
         size_t size = hnd->size;
         IMemAlloc* memalloc = getAllocator(hnd->flags) ;
         if(memalloc != NULL) {
-            err = memalloc->unmap_buffer(base, size, hnd->offset);
-            if (err) {
-                ALOGE("Could not unmap memory at address %p", base);
+            if (base) {
+                err = memalloc->unmap_buffer(base, size, hnd->offset);
+                if (err) {
+                    ALOGE("Could not unmap memory at address %p", base);
+                }
             }
             base = (void*)hnd->base_metadata;
             size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
-            err = memalloc->unmap_buffer(base, size, hnd->offset_metadata);
-            if (err) {
-                ALOGE("Could not unmap memory at address %p", base);
+            if (base) {
+                err = memalloc->unmap_buffer(base, size,
+                                             hnd->offset_metadata);
+                if (err) {
+                    ALOGE("Could not unmap memory at address %p", base);
+                }
             }
         }
     }
@@ -123,6 +136,117 @@ static pthread_mutex_t sMapLock = PTHREAD_MUTEX_INITIALIZER;
 
 /*****************************************************************************/
 
+// Software locks of RGB buffers only clean/invalidate the rows they cover,
+// unless that is most of the buffer anyway.
+#define PARTIAL_CACHE_OP_MAX_PERCENT 50
+#define CACHE_LINE_SIZE 64
+
+struct lockRange {
+    int fd;
+    size_t offset;
+    size_t length;
+};
+
+// Range of the buffers currently locked for software access, by handle
+static android::KeyedVector<private_handle_t*, lockRange> sLockRanges;
+static pthread_mutex_t sLockRangeLock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool getLockRange(private_handle_t* hnd, int t, int h,
+                         lockRange& range)
+{
+    int bpp;
+    switch (hnd->format) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            bpp = 4;
+            break;
+        case HAL_PIXEL_FORMAT_RGB_888:
+            bpp = 3;
+            break;
+        case HAL_PIXEL_FORMAT_RGB_565:
+            bpp = 2;
+            break;
+        default:
+            return false;
+    }
+    if ((hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER) ||
+        t < 0 || h <= 0 || t + h > hnd->height)
+        return false;
+
+    // hnd->width is the aligned width, i.e. the stride
+    size_t stride = hnd->width * bpp;
+    size_t start = (t * stride) & ~(CACHE_LINE_SIZE - 1);
+    size_t end = ALIGN((t + h) * stride, CACHE_LINE_SIZE);
+    if (end > (size_t)hnd->size)
+        end = hnd->size;
+    if ((end - start) * 100 > (size_t)hnd->size * PARTIAL_CACHE_OP_MAX_PERCENT)
+        return false;
+
+    range.fd = hnd->fd;
+    range.offset = start;
+    range.length = end - start;
+    return true;
+}
+
+static int cacheOp(IMemAlloc* memalloc, private_handle_t* hnd,
+                   const lockRange* range, int op)
+{
+    if (range) {
+        return memalloc->clean_buffer((void*)(hnd->base + range->offset),
+                                      range->length,
+                                      hnd->offset + range->offset,
+                                      hnd->fd, op);
+    }
+    return memalloc->clean_buffer((void*)hnd->base, hnd->size,
+                                  hnd->offset, hnd->fd, op);
+}
+
+// Remember what a lock covers for the unlock, nested locks add up
+static void addLockRange(private_handle_t* hnd, const lockRange* range)
+{
+    lockRange r;
+    if (range) {
+        r = *range;
+    } else {
+        r.fd = hnd->fd;
+        r.offset = 0;
+        r.length = hnd->size;
+    }
+    pthread_mutex_lock(&sLockRangeLock);
+    ssize_t idx = sLockRanges.indexOfKey(hnd);
+    if (idx >= 0) {
+        const lockRange& prev = sLockRanges.valueAt(idx);
+        if (prev.fd == r.fd) {
+            size_t end = r.offset + r.length;
+            if (prev.offset + prev.length > end)
+                end = prev.offset + prev.length;
+            if (prev.offset < r.offset)
+                r.offset = prev.offset;
+            r.length = end - r.offset;
+        }
+    }
+    sLockRanges.add(hnd, r);
+    pthread_mutex_unlock(&sLockRangeLock);
+}
+
+static bool takeLockRange(private_handle_t* hnd, lockRange& range)
+{
+    bool found = false;
+    pthread_mutex_lock(&sLockRangeLock);
+    ssize_t idx = sLockRanges.indexOfKey(hnd);
+    if (idx >= 0) {
+        range = sLockRanges.valueAt(idx);
+        sLockRanges.removeItemsAt(idx);
+        // Ignore a stale entry from a handle that was never unlocked
+        found = (range.fd == hnd->fd);
+    }
+    pthread_mutex_unlock(&sLockRangeLock);
+    return found;
+}
+
+/*****************************************************************************/
+
 int gralloc_register_buffer(gralloc_module_t const* module,
                             buffer_handle_t handle)
 {
@@ -141,7 +265,7 @@ int gralloc_register_buffer(gralloc_module_t const* module,
     private_handle_t* hnd = (private_handle_t*)handle;
     hnd->base = 0;
     hnd->base_metadata = 0;
-    int err = gralloc_map(module, handle);
+    int err = gralloc_map(module, handle, true);
     if (err) {
         ALOGE("%s: gralloc_map failed", __FUNCTION__);
         return err;
@@ -164,7 +288,11 @@ int gralloc_unregister_buffer(gralloc_module_t const* module,
 
     private_handle_t* hnd = (private_handle_t*)handle;
 
-    if (hnd->base != 0) {
+    // Drop the range of a lock that was never released
+    lockRange range;
+    takeLockRange(hnd, range);
+
+    if (hnd->base != 0 || hnd->base_metadata != 0) {
         gralloc_unmap(module, handle);
     }
     hnd->base = 0;
@@ -180,7 +308,7 @@ int terminateBuffer(gralloc_module_t const* module,
      * to un-map it. It's an error to be here with a locked buffer.
      */
 
-    if (hnd->base != 0) {
+    if (hnd->base != 0 || hnd->base_metadata != 0) {
         // this buffer was mapped, unmap it now
         if (hnd->flags & (private_handle_t::PRIV_FLAGS_USES_PMEM |
                           private_handle_t::PRIV_FLAGS_USES_PMEM_ADSP |
@@ -213,13 +341,20 @@ static int gralloc_map_and_invalidate (gralloc_module_t const* module,
             pthread_mutex_lock(lock);
             err = gralloc_map(module, handle);
             pthread_mutex_unlock(lock);
+            if (err) {
+                ALOGE("%s: failed to map buffer for lock, err=%d",
+                      __FUNCTION__, err);
+                return err;
+            }
         }
         //Invalidate if reading in software. No need to do this for the metadata
         //buffer as it is only read/written in software.
         IMemAlloc* memalloc = getAllocator(hnd->flags) ;
-        err = memalloc->clean_buffer((void*)hnd->base,
-                                     hnd->size, hnd->offset, hnd->fd,
-                                     CACHE_INVALIDATE);
+        lockRange range;
+        bool partial = getLockRange(hnd, t, h, range);
+        addLockRange(hnd, partial ? &range : NULL);
+        err = cacheOp(memalloc, hnd, partial ? &range : NULL,
+                      CACHE_INVALIDATE);
         if ((usage & GRALLOC_USAGE_SW_WRITE_MASK) &&
             !(hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER)) {
             // Mark the buffer to be flushed after cpu read/write
@@ -306,20 +441,18 @@ int gralloc_unlock(gralloc_module_t const* module,
     int err = 0;
     private_handle_t* hnd = (private_handle_t*)handle;
     IMemAlloc* memalloc = getAllocator(hnd->flags);
+    lockRange range;
+    const lockRange* pRange = takeLockRange(hnd, range) ? &range : NULL;
 
     if (hnd->flags & private_handle_t::PRIV_FLAGS_NEEDS_FLUSH) {
-        err = memalloc->clean_buffer((void*)hnd->base,
-                                     hnd->size, hnd->offset, hnd->fd,
-                                     CACHE_CLEAN_AND_INVALIDATE);
+        err = cacheOp(memalloc, hnd, pRange, CACHE_CLEAN_AND_INVALIDATE);
         hnd->flags &= ~private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
     } else if(hnd->flags & private_handle_t::PRIV_FLAGS_DO_NOT_FLUSH) {
         hnd->flags &= ~private_handle_t::PRIV_FLAGS_DO_NOT_FLUSH;
     } else {
         //Probably a round about way to do this, but this avoids adding new
         //flags
-        err = memalloc->clean_buffer((void*)hnd->base,
-                                     hnd->size, hnd->offset, hnd->fd,
-                                     CACHE_INVALIDATE);
+        err = cacheOp(memalloc, hnd, pRange, CACHE_INVALIDATE);
     }
 
     return err;
@@ -39,6 +39,8 @@
 using namespace qhwc;
 #define VSYNC_DEBUG 0
 #define BLANK_DEBUG 0
+//vsync-to-post is not recorded when the last vsync is older than this
+#define VSYNC_TO_POST_MAX_PERIODS 4
 
 static int hwc_device_open(const struct hw_module_t* module,
                            const char* name,
@@ -126,10 +128,12 @@ static int display_commit(hwc_context_t *ctx, int dpy) {
     struct mdp_display_commit commit_info;
     memset(&commit_info, 0, sizeof(struct mdp_display_commit));
     commit_info.flags = MDP_DISPLAY_COMMIT_OVERLAY;
+    nsecs_t start = systemTime();
     if(ioctl(fbFd, MSMFB_DISPLAY_COMMIT, &commit_info) == -1) {
        ALOGE("%s: MSMFB_DISPLAY_COMMIT for primary failed", __FUNCTION__);
        return -errno;
     }
+    qdutils::CompStats::record(qdutils::STAT_COMMIT, systemTime() - start);
     return 0;
 }
 
@@ -146,6 +150,7 @@ static int hwc_prepare_primary(hwc_composer_device_1 *dev,
         hwc_layer_1_t *fbLayer = &list->hwLayers[last];
         if(fbLayer->handle) {
             setListStats(ctx, list, dpy);
+            configurePPD(ctx, ctx->listStats[dpy].yuvCount);
             if(ctx->mMDPComp[dpy]->prepare(ctx, list) < 0)
                 ctx->mFBUpdate[dpy]->prepare(ctx, list, 0);
 
@@ -157,6 +162,20 @@ static int hwc_prepare_primary(hwc_composer_device_1 *dev,
     return 0;
 }
 
+//Frame rate of the video shown on a display, 0 if none or unknown
+static int getVideoFps(hwc_context_t *ctx, hwc_display_contents_1_t *list,
+        int dpy) {
+    for(int i = 0; i < ctx->listStats[dpy].yuvCount; i++) {
+        int index = ctx->listStats[dpy].yuvIndices[i];
+        private_handle_t *hnd =
+                (private_handle_t *)list->hwLayers[index].handle;
+        int fps = getRefreshRate(hnd);
+        if(fps > 0)
+            return fps;
+    }
+    return 0;
+}
+
 static int hwc_prepare_external(hwc_composer_device_1 *dev,
         hwc_display_contents_1_t *list, int dpy) {
     hwc_context_t* ctx = (hwc_context_t*)(dev);
@@ -171,6 +190,9 @@ static int hwc_prepare_external(hwc_composer_device_1 *dev,
             if(fbLayer->handle) {
                 ctx->mExtDispConfiguring = false;
                 setListStats(ctx, list, dpy);
+                if(dpy == HWC_DISPLAY_EXTERNAL)
+                    ctx->mExtDisplay->setContentFps(
+                            getVideoFps(ctx, list, dpy));
                 if(ctx->mMDPComp[dpy]->prepare(ctx, list) < 0)
                     ctx->mFBUpdate[dpy]->prepare(ctx, list, 0);
 
@@ -200,6 +222,7 @@ static int hwc_prepare(hwc_composer_device_1 *dev, size_t numDisplays,
 {
     int ret = 0;
     hwc_context_t* ctx = (hwc_context_t*)(dev);
+    nsecs_t start = systemTime();
     Locker::Autolock _l(ctx->mBlankLock);
     reset(ctx, numDisplays, displays);
 
@@ -227,6 +250,7 @@ static int hwc_prepare(hwc_composer_device_1 *dev, size_t numDisplays,
     ctx->mOverlay->configDone();
     ctx->mRotMgr->configDone();
 
+    qdutils::CompStats::record(qdutils::STAT_PREPARE, systemTime() - start);
     return ret;
 }
 
@@ -293,7 +317,9 @@ static int hwc_blank(struct hwc_composer_device_1* dev, int dpy, int blank)
                     ALOGE("%s:post failed for external display !! ",
                           __FUNCTION__);
                 }
-            } else {
+            } else if(dpy == HWC_DISPLAY_EXTERNAL && ctx->vstate.enable) {
+                // External vsync follows primary, catch up on unblank
+                hwc_vsync_control(ctx, dpy, 1);
             }
             break;
         default:
@@ -436,6 +462,10 @@ static int hwc_set_external(hwc_context_t *ctx,
             ALOGE("%s: display commit fail!", __FUNCTION__);
             ret = -1;
         }
+
+        // Refresh rate switches wait for the frame composed for them
+        if(dpy == HWC_DISPLAY_EXTERNAL)
+            ctx->mExtDisplay->applyPendingMode();
     }
 
     closeAcquireFds(list);
@@ -464,6 +494,7 @@ static int hwc_set(hwc_composer_device_1 *dev,
 {
     int ret = 0;
     hwc_context_t* ctx = (hwc_context_t*)(dev);
+    nsecs_t start = systemTime();
     Locker::Autolock _l(ctx->mBlankLock);
     for (uint32_t i = 0; i < numDisplays; i++) {
         hwc_display_contents_1_t* list = displays[i];
@@ -486,6 +517,15 @@ static int hwc_set(hwc_composer_device_1 *dev,
     CALC_FPS();
     MDPComp::resetIdleFallBack();
     ctx->mVideoTransFlag = false;
+
+    nsecs_t now = systemTime();
+    qdutils::CompStats::record(qdutils::STAT_SET, now - start);
+    //Only meaningful while vsync is on, i.e. the last one is recent
+    const VsyncTracker& t = ctx->vstate.tracker[HWC_DISPLAY_PRIMARY];
+    if(t.phase && t.period && (uint64_t)now > t.phase &&
+            (uint64_t)now - t.phase < VSYNC_TO_POST_MAX_PERIODS * t.period)
+        qdutils::CompStats::record(qdutils::STAT_VSYNC_TO_POST,
+                now - t.phase);
     return ret;
 }
 
@@ -576,6 +616,22 @@ void hwc_dump(struct hwc_composer_device_1* dev, char *buff, int buff_len)
     dumpsys_log(aBuf, "Qualcomm HWC state:\n");
     dumpsys_log(aBuf, "  MDPVersion=%d\n", ctx->mMDP.version);
     dumpsys_log(aBuf, "  DisplayPanel=%c\n", ctx->mMDP.panel);
+    dumpsys_log(aBuf, "  BufferSync: async=%u blocking=%u rotator=%u "
+            "fdDup=%u fdClose=%u\n", ctx->mSyncState.asyncSyncs,
+            ctx->mSyncState.blockingSyncs, ctx->mSyncState.rotSyncs,
+            ctx->mSyncState.fdsDuped, ctx->mSyncState.fdsClosed);
+    for(int dpy = 0; dpy < MAX_DISPLAYS; dpy++) {
+        const VsyncTracker& t = ctx->vstate.tracker[dpy];
+        if(!t.count)
+            continue;
+        dumpsys_log(aBuf, "  Vsync[%d]: fake=%d smooth=%d events=%u "
+                "missed=%u period=%lluns\n", dpy, ctx->vstate.fakevsync,
+                ctx->vstate.smooth, t.count, t.missed, t.period);
+    }
+    for(int dpy = 0; dpy < MAX_DISPLAYS; dpy++) {
+        if(ctx->mCopyBit[dpy])
+            ctx->mCopyBit[dpy]->dump(aBuf, dpy);
+    }
     for(int dpy = 0; dpy < MAX_DISPLAYS; dpy++) {
         if(ctx->mMDPComp[dpy])
             ctx->mMDPComp[dpy]->dump(aBuf);
@@ -586,6 +642,7 @@ void hwc_dump(struct hwc_composer_device_1* dev, char *buff, int buff_len)
     ovDump[0] = '\0';
     ctx->mRotMgr->getDump(ovDump, 2048);
     dumpsys_log(aBuf, ovDump);
+    qdutils::CompStats::dump(aBuf);
     strlcpy(buff, aBuf.string(), buff_len);
 }
 
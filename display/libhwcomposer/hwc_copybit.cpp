@@ -22,6 +22,7 @@
 #include <sync/sync.h>
 #include <copybit.h>
 #include <utils/Timers.h>
+#include <limits.h>
 #include "hwc_copybit.h"
 #include "comptype.h"
 #include "gr.h"
@@ -68,7 +69,49 @@ private:
     mutable range r;
 };
 
+// Stands for the whole render buffer in the damage tracking
+static const hwc_rect_t sFullRect = {0, 0, INT_MAX, INT_MAX};
+
+static bool isEmpty(const hwc_rect_t& r) {
+    return (r.right <= r.left) || (r.bottom <= r.top);
+}
+
+static hwc_rect_t getUnion(const hwc_rect_t& a, const hwc_rect_t& b) {
+    if(isEmpty(a))
+        return b;
+    if(isEmpty(b))
+        return a;
+    hwc_rect_t r = {min(a.left, b.left), min(a.top, b.top),
+                    max(a.right, b.right), max(a.bottom, b.bottom)};
+    return r;
+}
+
+static hwc_rect_t getIntersection(const hwc_rect_t& a, const hwc_rect_t& b) {
+    hwc_rect_t r = {max(a.left, b.left), max(a.top, b.top),
+                    min(a.right, b.right), min(a.bottom, b.bottom)};
+    return r;
+}
+
+static bool isSameRect(const hwc_rect_t& a, const hwc_rect_t& b) {
+    return (a.left == b.left) && (a.top == b.top) &&
+           (a.right == b.right) && (a.bottom == b.bottom);
+}
+
 void CopyBit::reset() {
+    // Render buffers can go once copybit has not been used for a while and
+    // the last one it drew is off the screen, i.e. two frames later.
+    if(mCopyBitDraw) {
+        mLastDrawTime = systemTime();
+        mIdleFrames = 0;
+    } else if(mIdleFrames < 2) {
+        mIdleFrames++;
+    } else if(systemTime() - mLastDrawTime > ms2ns(RENDER_BUFFER_IDLE_MS)) {
+        freeRenderBuffers();
+    }
+    // Damage of frames composed without copybit is not tracked, the render
+    // buffers need a full redraw when copybit is back.
+    if(!mCopyBitDraw)
+        mPrevLayerCount = -1;
     mIsModeOn = false;
     mCopyBitDraw = false;
 }
@@ -178,12 +221,13 @@ bool CopyBit::prepare(hwc_context_t *ctx, hwc_display_contents_1_t *list,
 
 
 
-    //Allocate render buffers if they're not allocated
+    //Find a render buffer, allocating it if needed
+    int nextRenderBuffer = -1;
     if (useCopybitForYUV || useCopybitForRGB) {
-        int ret = allocRenderBuffers(fbHnd->width,
-                                     fbHnd->height,
-                                     fbHnd->format);
-        if (ret < 0) {
+        nextRenderBuffer = getFreeRenderBuffer(fbHnd->width,
+                                               fbHnd->height,
+                                               fbHnd->format);
+        if (nextRenderBuffer < 0) {
             return false;
         }
     }
@@ -217,7 +261,7 @@ bool CopyBit::prepare(hwc_context_t *ctx, hwc_display_contents_1_t *list,
     }
     
     if (mCopyBitDraw) {
-        mCurRenderBufferIndex = (mCurRenderBufferIndex + 1) % NUM_RENDER_BUFFERS;
+        mCurRenderBufferIndex = nextRenderBuffer;
     }
     
     return true;
@@ -259,21 +303,44 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
         return false;
     }
 
-    //Wait for the previous frame to complete before rendering onto it
+    //Wait for the previous frame to complete before rendering onto it.
+    //Only happens when every render buffer is still in flight.
     if(mRelFd[mCurRenderBufferIndex] >= 0) {
+        mStalls++;
         sync_wait(mRelFd[mCurRenderBufferIndex], 1000);
         close(mRelFd[mCurRenderBufferIndex]);
         mRelFd[mCurRenderBufferIndex] = -1;
     }
 
+    //Only the area that changed since this buffer was last drawn needs
+    //to be composed again
+    updateDamage(ctx, list, dpy);
+    hwc_rect_t dirty = mBufferDirty[mCurRenderBufferIndex];
+    mBufferDirty[mCurRenderBufferIndex].left = 0;
+    mBufferDirty[mCurRenderBufferIndex].top = 0;
+    mBufferDirty[mCurRenderBufferIndex].right = 0;
+    mBufferDirty[mCurRenderBufferIndex].bottom = 0;
+
+    //A visible region with more rects than we can clip can't be limited
+    //to the dirty area, redraw the whole buffer instead
+    for (int i = 0; i < ctx->listStats[dpy].numAppLayers; i++) {
+        if((layerProp[i].mFlags & HWC_COPYBIT) &&
+           list->hwLayers[i].visibleRegionScreen.numRects > MAX_CLIP_RECTS) {
+            dirty = sFullRect;
+            break;
+        }
+    }
+
     //Clear the visible region on the render buffer
-    //XXX: Do this only when needed.
     hwc_rect_t clearRegion;
     if (ctx->mFBUpdate[dpy]->getZorder() == 0)
         clearRegion = list->hwLayers[list->numHwLayers - 1].sourceCrop;
     else	
     	getNonWormholeRegion(list, clearRegion);
-    clear(renderBuffer, clearRegion);
+    clearRegion = getIntersection(clearRegion, dirty);
+    bool cleared = false;
+    if (!isEmpty(clearRegion))
+        cleared = (clear(renderBuffer, clearRegion) == 0);
 
     int renderTransform = list->hwLayers[list->numHwLayers - 1].transform;
     
@@ -283,6 +350,11 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
             ALOGD_IF(DEBUG_COPYBIT, "%s: Not Marked for copybit", __FUNCTION__);
             continue;
         }
+        if(isEmpty(getIntersection(layer->displayFrame, dirty))) {
+            // Still up to date in this render buffer
+            mDirtySkips++;
+            continue;
+        }
         int ret = -1;
         if (list->hwLayers[i].acquireFenceFd != -1 ) {
             // Wait for acquire Fence on the App buffers.
@@ -297,14 +369,14 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
         retVal = drawLayerUsingCopybit(ctx, &(list->hwLayers[i]),
                                                     renderBuffer, 
                                                     renderTransform,
-                                                    dpy);
+                                                    dpy, dirty);
         copybitLayerCount++;
         if(retVal < 0) {
             ALOGE("%s : drawLayerUsingCopybit failed", __FUNCTION__);
         }
     }
 
-    if (copybitLayerCount) {
+    if (copybitLayerCount || cleared) {
         copybit_device_t *copybit = getCopyBitDevice();
 #ifdef HWC_COPYBIT_ASYNC
         // Async mode
@@ -321,7 +393,8 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
 
 int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
                                      private_handle_t *renderBuffer, 
-                                     int renderTransform, int dpy)
+                                     int renderTransform, int dpy,
+                                     const hwc_rect_t& dirty)
 {
     hwc_context_t* ctx = (hwc_context_t*)(dev);
     int err = 0;
@@ -495,8 +568,20 @@ int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
             srcRect = tmp_rect;
       }
     }
-    // Copybit region
+    // Copybit region, clipped to the dirty area. draw() makes the whole
+    // buffer dirty when a region has too many rects to clip.
     hwc_region_t region = layer->visibleRegionScreen;
+    hwc_rect_t clipRects[MAX_CLIP_RECTS];
+    if (region.numRects <= MAX_CLIP_RECTS) {
+        size_t numClipRects = 0;
+        for (size_t i = 0; i < region.numRects; i++) {
+            hwc_rect_t r = getIntersection(region.rects[i], dirty);
+            if (!isEmpty(r))
+                clipRects[numClipRects++] = r;
+        }
+        region.numRects = numClipRects;
+        region.rects = clipRects;
+    }
     region_iterator copybitRegion(region);
 
     copybit->set_parameter(copybit, COPYBIT_FRAMEBUFFER_WIDTH,
@@ -549,26 +634,103 @@ bool CopyBit::validateParams(hwc_context_t *ctx,
 }
 
 
-int CopyBit::allocRenderBuffers(int w, int h, int f)
+/* Work out what changed since the last copybit frame: the old and new
+ * position of every copybit layer that got a new buffer, moved or was
+ * moved between copybit and MDP. Geometry changes redraw everything.
+ * The result is added to the dirty area of every render buffer.
+ */
+void CopyBit::updateDamage(hwc_context_t *ctx, hwc_display_contents_1_t *list,
+                           int dpy)
 {
-    int ret = 0;
-    for (int i = 0; i < NUM_RENDER_BUFFERS; i++) {
-        if (mRenderBuffer[i] == NULL) {
-            ret = alloc_buffer(&mRenderBuffer[i],
-                               w, h, f,
-                               0);
+    int numAppLayers = ctx->listStats[dpy].numAppLayers;
+    LayerProp *layerProp = ctx->layerProp[dpy];
+    hwc_rect_t damage = {0, 0, 0, 0};
+    bool fullDamage = !mDirtyTracking ||
+                      (list->flags & HWC_GEOMETRY_CHANGED) ||
+                      (mPrevLayerCount != numAppLayers);
+
+    for (int i = 0; i < numAppLayers && i < MAX_NUM_LAYERS; i++) {
+        hwc_layer_1_t *layer = &list->hwLayers[i];
+        LayerState& prev = mPrevLayers[i];
+        bool copybit = (layerProp[i].mFlags & HWC_COPYBIT) != 0;
+
+        if (!fullDamage &&
+            ((prev.handle != layer->handle) ||
+             (prev.copybit != copybit) ||
+             !isSameRect(prev.displayFrame, layer->displayFrame) ||
+             !isSameRect(prev.sourceCrop, layer->sourceCrop) ||
+             (prev.transform != layer->transform) ||
+             (prev.blending != layer->blending) ||
+             (prev.planeAlpha != layer->planeAlpha))) {
+            if (prev.copybit)
+                damage = getUnion(damage, prev.displayFrame);
+            if (copybit)
+                damage = getUnion(damage, layer->displayFrame);
         }
-        if(ret < 0) {
-            freeRenderBuffers();
-            break;
+
+        prev.handle = layer->handle;
+        prev.displayFrame = layer->displayFrame;
+        prev.sourceCrop = layer->sourceCrop;
+        prev.transform = layer->transform;
+        prev.blending = layer->blending;
+        prev.planeAlpha = layer->planeAlpha;
+        prev.copybit = copybit;
+    }
+    mPrevLayerCount = numAppLayers;
+
+    if (fullDamage)
+        damage = sFullRect;
+    for (int i = 0; i < mNumRenderBuffers; i++)
+        mBufferDirty[i] = getUnion(mBufferDirty[i], damage);
+}
+
+/* Pick the render buffer for the next frame: the first one the display has
+ * released, checked without blocking on its fence. Buffers are allocated
+ * on demand up to the configured depth. When all of them are still in
+ * flight the oldest one is returned and draw() waits for it.
+ */
+int CopyBit::getFreeRenderBuffer(int w, int h, int f)
+{
+    int unallocated = -1;
+    // The current buffer is on screen, never hand it out while there are
+    // others to pick from
+    for (int i = 1; i < mNumRenderBuffers; i++) {
+        int index = (mCurRenderBufferIndex + i) % mNumRenderBuffers;
+        if (mRenderBuffer[index] == NULL) {
+            if (unallocated < 0)
+                unallocated = index;
+            continue;
+        }
+        if (mRelFd[index] < 0)
+            return index;
+        if (sync_wait(mRelFd[index], 0) == 0) {
+            close(mRelFd[index]);
+            mRelFd[index] = -1;
+            return index;
         }
     }
-    return ret;
+
+    if (unallocated >= 0) {
+        if (alloc_buffer(&mRenderBuffer[unallocated], w, h, f, 0) == 0) {
+            mBufferDirty[unallocated] = sFullRect;
+            return unallocated;
+        }
+        // Never fall back to the buffer on screen, let prepare use GLES
+        mRenderBuffer[unallocated] = NULL;
+        return -1;
+    }
+
+    for (int i = 1; i < mNumRenderBuffers; i++) {
+        int index = (mCurRenderBufferIndex + i) % mNumRenderBuffers;
+        if (mRenderBuffer[index])
+            return index;
+    }
+    return -1;
 }
 
 void CopyBit::freeRenderBuffers()
 {
-    for (int i = 0; i < NUM_RENDER_BUFFERS; i++) {
+    for (int i = 0; i < MAX_RENDER_BUFFERS; i++) {
         if(mRenderBuffer[i]) {
             //Since we are freeing buffer close the fence if it has a valid one.
             if(mRelFd[i] >= 0) {
@@ -581,6 +743,15 @@ void CopyBit::freeRenderBuffers()
     }
 }
 
+void CopyBit::release()
+{
+    freeRenderBuffers();
+    mCurRenderBufferIndex = 0;
+    mPrevLayerCount = -1;
+    mIsModeOn = false;
+    mCopyBitDraw = false;
+}
+
 private_handle_t * CopyBit::getCurrentRenderBuffer() {
     return mRenderBuffer[mCurRenderBufferIndex];
 }
@@ -593,22 +764,46 @@ void CopyBit::setReleaseFd(int fd) {
     }
 }
 
+void CopyBit::dump(android::String8& buf, int dpy) {
+    int allocated = 0;
+    for (int i = 0; i < mNumRenderBuffers; i++) {
+        if(mRenderBuffer[i])
+            allocated++;
+    }
+    dumpsys_log(buf, "  CopyBit[%d]: renderBuffers=%d/%d stalls=%u "
+                "dirtyTracking=%d dirtySkips=%u\n", dpy, allocated,
+                mNumRenderBuffers, mStalls, mDirtyTracking, mDirtySkips);
+}
+
 struct copybit_device_t* CopyBit::getCopyBitDevice() {
     return mEngine;
 }
 
 CopyBit::CopyBit():mIsModeOn(false), mCopyBitDraw(false),
-    mCurRenderBufferIndex(0){
+    mCurRenderBufferIndex(0), mLastDrawTime(0), mIdleFrames(0), mStalls(0),
+    mPrevLayerCount(-1), mDirtySkips(0){
     hw_module_t const *module;
-    for (int i = 0; i < NUM_RENDER_BUFFERS; i++) {
+    for (int i = 0; i < MAX_RENDER_BUFFERS; i++) {
         mRenderBuffer[i] = NULL;
         mRelFd[i] = -1;
+        mBufferDirty[i] = sFullRect;
     }
 
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.hwc.dynThreshold", value, "2");
     mDynThreshold = atof(value);
 
+    property_get("debug.hwc.copybit.dirty", value, "1");
+    mDirtyTracking = (atoi(value) != 0);
+
+    mNumRenderBuffers = NUM_RENDER_BUFFERS;
+    if(property_get("debug.hwc.copybit.buffers", value, NULL) > 0)
+        mNumRenderBuffers = atoi(value);
+    if(mNumRenderBuffers < 2)
+        mNumRenderBuffers = 2;
+    else if(mNumRenderBuffers > MAX_RENDER_BUFFERS)
+        mNumRenderBuffers = MAX_RENDER_BUFFERS;
+
     if (hw_get_module(COPYBIT_HARDWARE_MODULE_ID, &module) == 0) {
         if(copybit_open(module, &mEngine) < 0) {
             ALOGE("FATAL ERROR: copybit open failed.");
@@ -21,7 +21,10 @@
 #define HWC_COPYBIT_H
 #include "hwc_utils.h"
 
-#define NUM_RENDER_BUFFERS 3
+#define NUM_RENDER_BUFFERS 3 // Default render buffer depth
+#define MAX_RENDER_BUFFERS 4
+#define RENDER_BUFFER_IDLE_MS 2000 // Free render buffers when unused this long
+#define MAX_CLIP_RECTS 32 // Visible region rects clipped to the dirty rect
 
 namespace qhwc {
 
@@ -39,18 +42,24 @@ public:
                                                         int dpy, int* fd);
     // resets the values
     void reset();
+    // Drops the render buffers and damage history, used when the display
+    // goes away and the object is kept for the next connect
+    void release();
 
     private_handle_t * getCurrentRenderBuffer();
 
     void setReleaseFd(int fd);
 
+    void dump(android::String8& buf, int dpy);
+
 private:
     // holds the copybit device
     struct copybit_device_t *mEngine;
     // Helper functions for copybit composition
     int  drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
                                        private_handle_t *renderBuffer, 
-                                       int renderTransform, int dpy);
+                                       int renderTransform, int dpy,
+                                       const hwc_rect_t& dirty);
     bool canUseCopybitForYUV (hwc_context_t *ctx);
     bool canUseCopybitForRGB (hwc_context_t *ctx,
                                      hwc_display_contents_1_t *list, int dpy);
@@ -67,19 +76,56 @@ private:
     void getLayerResolution(const hwc_layer_1_t* layer,
                                    unsigned int &width, unsigned int& height);
 
-    int allocRenderBuffers(int w, int h, int f);
+    int getFreeRenderBuffer(int w, int h, int f);
+
+    void updateDamage(hwc_context_t *ctx, hwc_display_contents_1_t *list,
+                      int dpy);
 
     void freeRenderBuffers();
 
     int clear (private_handle_t* hnd, hwc_rect_t& rect);
 
-    private_handle_t* mRenderBuffer[NUM_RENDER_BUFFERS];
+    private_handle_t* mRenderBuffer[MAX_RENDER_BUFFERS];
+
+    // Number of render buffers in the rotation, debug.hwc.copybit.buffers
+    int mNumRenderBuffers;
 
     // Index of the current intermediate render buffer
     int mCurRenderBufferIndex;
 
     // Release FDs of the intermediate render buffer
-    int mRelFd[NUM_RENDER_BUFFERS];
+    int mRelFd[MAX_RENDER_BUFFERS];
+
+    // Last time a frame was composed with copybit and the number of
+    // frames composed without it since, used to trim the render buffers
+    nsecs_t mLastDrawTime;
+    int mIdleFrames;
+
+    // Frames that had to wait for a render buffer to be released
+    uint32_t mStalls;
+
+    // State of the app layers in the last copybit frame
+    struct LayerState {
+        buffer_handle_t handle;
+        hwc_rect_t displayFrame;
+        hwc_rect_t sourceCrop;
+        uint32_t transform;
+        int32_t blending;
+        uint8_t planeAlpha;
+        bool copybit;
+    };
+    LayerState mPrevLayers[MAX_NUM_LAYERS];
+    // Number of valid entries in mPrevLayers, -1 after a non copybit frame
+    int mPrevLayerCount;
+
+    // Area each render buffer is missing since it was last drawn
+    hwc_rect_t mBufferDirty[MAX_RENDER_BUFFERS];
+
+    // Compose only the dirty area, debug.hwc.copybit.dirty
+    bool mDirtyTracking;
+
+    // Layers skipped as they were outside of the dirty area
+    uint32_t mDirtySkips;
 
     //Dynamic composition threshold for deciding copybit usage.
     double mDynThreshold;
@@ -66,7 +66,8 @@ bool FBUpdateLowRes::configure(hwc_context_t *ctx, hwc_display_contents_1 *list,
                           ovutils::getMdpFormat(hnd->format), hnd->size);
 
         //Request an RGB pipe
-        ovutils::eDest dest = ov.nextPipe(ovutils::OV_MDP_PIPE_ANY, mDpy);
+        ovutils::eDest dest = ov.nextPipe(ovutils::OV_MDP_PIPE_ANY, mDpy,
+                overlay::Overlay::KEY_FB);
         if(dest == ovutils::OV_INVALID) { //None available
             ALOGE("%s: No pipes available to configure framebuffer",
                 __FUNCTION__);
@@ -35,6 +35,8 @@ namespace qhwc {
 
 IdleInvalidator *MDPComp::idleInvalidator = NULL;
 bool MDPComp::sIdleFallBack = false;
+bool MDPComp::sIdleFrameDone = false;
+uint32_t MDPComp::sIdleCount = 0;
 bool MDPComp::sDebugLogs = false;
 bool MDPComp::sEnabled = false;
 int MDPComp::sMaxPipesPerMixer = MAX_PIPES_PER_MIXER;
@@ -55,6 +57,11 @@ void MDPComp::dump(android::String8& buf)
     dumpsys_log(buf,"needsFBRedraw:%3s  pipesUsed:%2d  MaxPipesPerMixer: %d \n",
                 (mCurrentFrame.needsRedraw? "YES" : "NO"),
                 mCurrentFrame.mdpCount, sMaxPipesPerMixer);
+    if(idleInvalidator)
+        dumpsys_log(buf,"IdleTimeout: %ums  idleFired: %u  idleFrames: %u  "
+                    "idleFallBack:%3s\n", idleInvalidator->getIdleTime(),
+                    idleInvalidator->getFireCount(), sIdleCount,
+                    (sIdleFallBack ? "YES" : "NO"));
     dumpsys_log(buf," ---------------------------------------------  \n");
     dumpsys_log(buf," listIdx | cached? | mdpIndex | comptype  |  Z  \n");
     dumpsys_log(buf," ---------------------------------------------  \n");
@@ -137,6 +144,15 @@ void MDPComp::timeout_handler(void *udata) {
     ctx->proc->invalidate(ctx->proc);
 }
 
+void MDPComp::resetIdleFallBack() {
+    /* The timer may fire between a prepare and its set, keep idle mode
+     * until a frame has actually been composed for it. */
+    if(sIdleFrameDone) {
+        sIdleFallBack = false;
+        sIdleFrameDone = false;
+    }
+}
+
 void MDPComp::setMDPCompLayerFlags(hwc_context_t *ctx,
                                    hwc_display_contents_1_t* list) {
     LayerProp *layerProp = ctx->layerProp[mDpy];
@@ -370,20 +386,21 @@ bool MDPComp::isSupported(hwc_context_t *ctx, hwc_display_contents_1_t* list, in
     return true;
 }
 
-ovutils::eDest MDPComp::getMdpPipe(hwc_context_t *ctx, ePipeType type) {
+ovutils::eDest MDPComp::getMdpPipe(hwc_context_t *ctx, ePipeType type,
+        int key) {
     overlay::Overlay& ov = *ctx->mOverlay;
     ovutils::eDest mdp_pipe = ovutils::OV_INVALID;
 
     switch(type) {
     case MDPCOMP_OV_DMA:
-        mdp_pipe = ov.nextPipe(ovutils::OV_MDP_PIPE_DMA, mDpy);
+        mdp_pipe = ov.nextPipe(ovutils::OV_MDP_PIPE_DMA, mDpy, key);
         if(mdp_pipe != ovutils::OV_INVALID) {
             ctx->mDMAInUse = true;
             return mdp_pipe;
         }
     case MDPCOMP_OV_ANY:
     case MDPCOMP_OV_RGB:
-        mdp_pipe = ov.nextPipe(ovutils::OV_MDP_PIPE_RGB, mDpy);
+        mdp_pipe = ov.nextPipe(ovutils::OV_MDP_PIPE_RGB, mDpy, key);
         if(mdp_pipe != ovutils::OV_INVALID) {
             return mdp_pipe;
         }
@@ -393,7 +410,7 @@ ovutils::eDest MDPComp::getMdpPipe(hwc_context_t *ctx, ePipeType type) {
             break;
         }
     case  MDPCOMP_OV_VG:
-        return ov.nextPipe(ovutils::OV_MDP_PIPE_VG, mDpy);
+        return ov.nextPipe(ovutils::OV_MDP_PIPE_VG, mDpy, key);
     default:
         ALOGE("%s: Invalid pipe type",__FUNCTION__);
         return ovutils::OV_INVALID;
@@ -856,12 +873,29 @@ void MDPComp::reset(const int& numLayers, hwc_display_contents_1_t* list) {
     mCachedFrame.updateCounts(mCurrentFrame);
 }
 
+void MDPComp::invalidate() {
+    mCurrentFrame.reset(0);
+    mCachedFrame.reset();
+    fbHandle = 0;
+}
+
 int MDPComp::prepare(hwc_context_t *ctx, hwc_display_contents_1_t* list) {
 
     //reset old data
     const int numLayers = ctx->listStats[mDpy].numAppLayers;
     mCurrentFrame.reset(numLayers);
 
+    //Idle: collapse the whole frame into the FB target so all other overlay
+    //pipes and rotator sessions are released until the next update.
+    if(sIdleFallBack && mDpy == HWC_DISPLAY_PRIMARY) {
+        ALOGD_IF(isDebug(), "%s: Idle fallback, composing on FB", __FUNCTION__);
+        if(!sIdleFrameDone)
+            sIdleCount++;
+        sIdleFrameDone = true;
+        reset(numLayers, list);
+        return -1;
+    }
+
     //Hard conditions, if not met, cannot do MDP comp
     if(!isFrameDoable(ctx)) {
         ALOGD_IF( isDebug(),"%s: MDP Comp not possible for this frame",
@@ -996,7 +1030,8 @@ bool MDPComp::allocLayerPipes(hwc_context_t *ctx,
                                     hwc_display_contents_1_t* list) {
     if (!mCurrentFrame.isFBComposed[0] && 
     	!isValidBaseLayer(ctx, &list->hwLayers[0])) {
-    	mCurrentFrame.mdpBasePipe = getMdpPipe(ctx, MDPCOMP_OV_ANY);
+    	mCurrentFrame.mdpBasePipe = getMdpPipe(ctx, MDPCOMP_OV_ANY,
+                overlay::Overlay::KEY_BASE);
 		if (mCurrentFrame.mdpBasePipe == ovutils::OV_INVALID) {
 			ALOGD_IF(isDebug(), "%s: Unable to get pipe for base pipe",
                          __FUNCTION__);
@@ -1022,7 +1057,8 @@ bool MDPComp::allocLayerPipes(hwc_context_t *ctx,
             info.rot = NULL;
             MdpPipeInfo& pipe_info = *info.pipeInfo;
 
-            pipe_info.index = getMdpPipe(ctx, MDPCOMP_OV_VG);
+            pipe_info.index = getMdpPipe(ctx, MDPCOMP_OV_VG,
+                    overlay::Overlay::KEY_LAYER + nYuvIndex);
             if(pipe_info.index == ovutils::OV_INVALID) {
                 ALOGD_IF(isDebug(), "%s: Unable to get pipe for Videos",
                          __FUNCTION__);
@@ -1053,7 +1089,8 @@ bool MDPComp::allocLayerPipes(hwc_context_t *ctx,
             type = MDPCOMP_OV_DMA;
         }
 
-        pipe_info.index = getMdpPipe(ctx, type);
+        pipe_info.index = getMdpPipe(ctx, type,
+                overlay::Overlay::KEY_LAYER + index);
         if(pipe_info.index == ovutils::OV_INVALID) {
             ALOGD_IF(isDebug(), "%s: Unable to get pipe for UI", __FUNCTION__);
             return false;
@@ -45,13 +45,16 @@ public:
     bool draw(hwc_context_t *ctx, hwc_display_contents_1_t *list);
     /* dumpsys */
     void dump(android::String8& buf);
+    /* forgets the cached frame, used when the display is reconnected */
+    void invalidate();
 
     static MDPComp* getObject(const int& width, const int dpy);
     /* Handler to invoke frame redraw on Idle Timer expiry */
     static void timeout_handler(void *udata);
     /* Initialize MDP comp*/
     static bool init(hwc_context_t *ctx);
-    static void resetIdleFallBack() { sIdleFallBack = false; }
+    /* Leaves idle mode once the collapsed frame has been posted */
+    static void resetIdleFallBack();
 
     void cacheFbHandle(buffer_handle_t handle) { fbHandle = handle; }
     buffer_handle_t getFbHandle() { 
@@ -132,7 +135,7 @@ protected:
     void setMDPCompLayerFlags(hwc_context_t *ctx,
                               hwc_display_contents_1_t* list);
     /* allocate MDP pipes from overlay */
-    ovutils::eDest getMdpPipe(hwc_context_t *ctx, ePipeType type);
+    ovutils::eDest getMdpPipe(hwc_context_t *ctx, ePipeType type, int key);
 
     /* checks for conditions where mdpcomp is not possible */
     bool isFrameDoable(hwc_context_t *ctx);
@@ -173,6 +176,9 @@ protected:
     static bool sEnabled;
     static bool sDebugLogs;
     static bool sIdleFallBack;
+    /* Idle frame was composed on FB, set() may leave idle mode */
+    static bool sIdleFrameDone;
+    static uint32_t sIdleCount;
     static int sMaxPipesPerMixer;
     static IdleInvalidator *idleInvalidator;
     struct FrameInfo mCurrentFrame;
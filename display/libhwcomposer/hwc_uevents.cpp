@@ -44,6 +44,9 @@ enum {
     EXTERNAL_RESUME
 };
 
+// Display used for WFD, persist.sys.wfd.virtual is read once at start up
+static int sWfdDpyNum = HWC_DISPLAY_EXTERNAL;
+
 static bool isHDMI(const char* str)
 {
     if(strcasestr("change@/devices/virtual/switch/hdmi", str))
@@ -51,6 +54,54 @@ static bool isHDMI(const char* str)
     return false;
 }
 
+// Composition objects of a disconnected external display are kept, and
+// handed back on its next connect instead of being created again.
+static void parkExtObjects(hwc_context_t* ctx, int dpy)
+{
+    Locker::Autolock _l(ctx->mExtSetLock);
+    if(ctx->mFBUpdate[dpy]) {
+        ctx->mFBUpdate[dpy]->reset();
+        ctx->mExtFBUpdate[dpy] = ctx->mFBUpdate[dpy];
+        ctx->mFBUpdate[dpy] = NULL;
+    }
+    if(ctx->mCopyBit[dpy]) {
+        ctx->mCopyBit[dpy]->release();
+        ctx->mExtCopyBit[dpy] = ctx->mCopyBit[dpy];
+        ctx->mCopyBit[dpy] = NULL;
+    }
+    if(ctx->mMDPComp[dpy]) {
+        ctx->mMDPComp[dpy]->invalidate();
+        ctx->mExtMDPComp[dpy] = ctx->mMDPComp[dpy];
+        ctx->mMDPComp[dpy] = NULL;
+    }
+}
+
+static void restoreExtObjects(hwc_context_t* ctx, int dpy, bool usecopybit)
+{
+    if(ctx->mExtFBUpdate[dpy]) {
+        ctx->mFBUpdate[dpy] = ctx->mExtFBUpdate[dpy];
+        ctx->mExtFBUpdate[dpy] = NULL;
+    } else {
+        ctx->mFBUpdate[dpy] =
+                IFBUpdate::getObject(ctx->dpyAttr[dpy].xres, dpy);
+    }
+    if(usecopybit) {
+        if(ctx->mExtCopyBit[dpy]) {
+            ctx->mCopyBit[dpy] = ctx->mExtCopyBit[dpy];
+            ctx->mExtCopyBit[dpy] = NULL;
+        } else {
+            ctx->mCopyBit[dpy] = new CopyBit();
+        }
+    }
+    if(ctx->mExtMDPComp[dpy]) {
+        ctx->mMDPComp[dpy] = ctx->mExtMDPComp[dpy];
+        ctx->mExtMDPComp[dpy] = NULL;
+    } else {
+        ctx->mMDPComp[dpy] =  MDPComp::getObject(
+                ctx->dpyAttr[dpy].xres, dpy);
+    }
+}
+
 static void handle_uevent(hwc_context_t* ctx, const char* udata, int len)
 {
     const char *str = udata;
@@ -70,17 +121,7 @@ static void handle_uevent(hwc_context_t* ctx, const char* udata, int len)
         return;
     }
     int connected = -1; // initial value - will be set to  1/0 based on hotplug
-    int extDpyNum = HWC_DISPLAY_EXTERNAL;
-    char property[PROPERTY_VALUE_MAX];
-    if((property_get("persist.sys.wfd.virtual", property, NULL) > 0) &&
-            (!strncmp(property, "1", PROPERTY_VALUE_MAX ) ||
-             (!strncasecmp(property,"true", PROPERTY_VALUE_MAX )))) {
-        // This means we are using Google API to trigger WFD Display
-        extDpyNum = HWC_DISPLAY_VIRTUAL;
-
-    }
-
-    int dpy = isHDMI(str) ? HWC_DISPLAY_EXTERNAL : extDpyNum;
+    int dpy = isHDMI(str) ? HWC_DISPLAY_EXTERNAL : sWfdDpyNum;
 
     // update extDpyNum
     ctx->mExtDisplay->setExtDpyNum(dpy);
@@ -109,20 +150,7 @@ static void handle_uevent(hwc_context_t* ctx, const char* udata, int len)
         case EXTERNAL_OFFLINE:
             {   // disconnect event
                 ctx->mExtDisplay->processUEventOffline(udata);
-                if(ctx->mFBUpdate[dpy]) {
-                    Locker::Autolock _l(ctx->mExtSetLock);
-                    delete ctx->mFBUpdate[dpy];
-                    ctx->mFBUpdate[dpy] = NULL;
-                }
-                if(ctx->mCopyBit[dpy]){
-                    Locker::Autolock _l(ctx->mExtSetLock);
-                    delete ctx->mCopyBit[dpy];
-                    ctx->mCopyBit[dpy] = NULL;
-                }
-                if(ctx->mMDPComp[dpy]) {
-                    delete ctx->mMDPComp[dpy];
-                    ctx->mMDPComp[dpy] = NULL;
-                }
+                parkExtObjects(ctx, dpy);
                 ALOGD("%s sending hotplug: connected = %d and dpy:%d",
                       __FUNCTION__, connected, dpy);
                 ctx->dpyAttr[dpy].connected = false;
@@ -135,13 +163,8 @@ static void handle_uevent(hwc_context_t* ctx, const char* udata, int len)
             {   // connect case
                 ctx->mExtDispConfiguring = true;
                 ctx->mExtDisplay->processUEventOnline(udata);
-                ctx->mFBUpdate[dpy] =
-                        IFBUpdate::getObject(ctx->dpyAttr[dpy].xres, dpy);
+                restoreExtObjects(ctx, dpy, usecopybit);
                 ctx->dpyAttr[dpy].isPause = false;
-                if(usecopybit)
-                    ctx->mCopyBit[dpy] = new CopyBit();
-                ctx->mMDPComp[dpy] =  MDPComp::getObject(
-                        ctx->dpyAttr[dpy].xres, dpy);
                 ALOGD("%s sending hotplug: connected = %d", __FUNCTION__,
                         connected);
                 ctx->dpyAttr[dpy].connected = true;
@@ -184,6 +207,14 @@ static void *uevent_loop(void *param)
     setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
     uevent_init();
 
+    char property[PROPERTY_VALUE_MAX];
+    if((property_get("persist.sys.wfd.virtual", property, NULL) > 0) &&
+            (!strncmp(property, "1", PROPERTY_VALUE_MAX ) ||
+             (!strncasecmp(property,"true", PROPERTY_VALUE_MAX )))) {
+        // This means we are using Google API to trigger WFD Display
+        sWfdDpyNum = HWC_DISPLAY_VIRTUAL;
+    }
+
     while(1) {
         len = uevent_next_event(udata, sizeof(udata) - 2);
         handle_uevent(ctx, udata, len);
@@ -102,9 +102,31 @@ struct LayerProp {
     LayerProp():mFlags(0) {};
 };
 
+struct VsyncTracker {
+    uint64_t phase;   //last delivered timestamp, nanos
+    uint64_t period;  //estimated vsync period, nanos
+    uint32_t count;   //vsync events seen
+    uint32_t missed;  //vsync periods elapsed without an event
+    bool restart;     //vsync was re-enabled, the next event starts over
+};
+
 struct VsyncState {
     bool enable;
     bool fakevsync;
+    //Deliver filtered instead of raw hardware timestamps, off by default
+    bool smooth;
+    VsyncTracker tracker[MAX_DISPLAYS];
+};
+
+struct SyncState {
+    //debug.egl.swapinterval == 0, read once at init
+    bool swapIntervalZero;
+    //Fence bookkeeping for hwc_sync, reported in dumpsys
+    uint32_t asyncSyncs;
+    uint32_t blockingSyncs;
+    uint32_t rotSyncs;
+    uint32_t fdsDuped;
+    uint32_t fdsClosed;
 };
 
 struct CablProp {
@@ -152,10 +174,13 @@ inline overlay::Rotator* LayerRotMap::getRot(uint32_t index) const {
 }
 
 // -----------------------------------------------------------------------------
-// Utility functions - implemented in hwc_utils.cpp
+// Utility functions - implemented in hwc_utils.cpp and, for the ones that
+// never touch a device, hwc_layer_utils.cpp
 void dumpLayer(hwc_layer_1_t const* l);
 void setListStats(hwc_context_t *ctx, const hwc_display_contents_1_t *list,
         int dpy);
+//Switches CABL in the pp daemon on/off when video starts/stops
+void configurePPD(hwc_context_t *ctx, int yuvCount);
 void initContext(hwc_context_t *ctx);
 void closeContext(hwc_context_t *ctx);
 //Crops source buffer against destination and FB boundaries
@@ -237,6 +262,17 @@ static inline bool isExtBlock(const private_handle_t* hnd) {
     return (hnd && (hnd->flags & private_handle_t::PRIV_FLAGS_EXTERNAL_BLOCK));
 }
 
+//Frame rate of a video buffer as set by its producer, 0 if not known
+static inline int getRefreshRate(const private_handle_t* hnd) {
+    if(isYuvBuffer(hnd)) {
+        MetaData_t *metadata = (MetaData_t *)hnd->base_metadata;
+        if(metadata && metadata->operation & UPDATE_REFRESH_RATE) {
+            return metadata->refreshrate;
+        }
+    }
+    return 0;
+}
+
 //Return true if buffer is for external display only with a Close Caption flag.
 static inline bool isExtCC(const private_handle_t* hnd) {
     return (hnd && (hnd->flags & private_handle_t::PRIV_FLAGS_EXTERNAL_CC));
@@ -316,11 +352,16 @@ struct hwc_context_t {
     qhwc::ExternalDisplay *mExtDisplay;
     qhwc::MDPInfo mMDP;
     qhwc::VsyncState vstate;
+    qhwc::SyncState mSyncState;
     qhwc::DisplayAttributes dpyAttr[MAX_DISPLAYS];
     qhwc::ListStats listStats[MAX_DISPLAYS];
     qhwc::LayerProp *layerProp[MAX_DISPLAYS];
     qhwc::LayerRotMap *mLayerRotMap[MAX_DISPLAYS];
     qhwc::MDPComp *mMDPComp[MAX_DISPLAYS];
+    //External display objects parked across hotplugs
+    qhwc::CopyBit *mExtCopyBit[MAX_DISPLAYS];
+    qhwc::IFBUpdate *mExtFBUpdate[MAX_DISPLAYS];
+    qhwc::MDPComp *mExtMDPComp[MAX_DISPLAYS];
     qhwc::CablProp mCablProp;
     overlay::utils::Whf mPrevWHF[MAX_DISPLAYS];
 
@@ -25,6 +25,7 @@
 #include <linux/msm_mdp.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
+#include <time.h>
 #include "hwc_utils.h"
 #include "string.h"
 #include "external.h"
@@ -32,6 +33,13 @@
 namespace qhwc {
 
 #define HWC_VSYNC_THREAD_NAME "hwcVsyncThread"
+#define HWC_EXT_VSYNC_THREAD_NAME "hwcExtVsyncThread"
+
+//Filter weights for phase and period corrections, as right shifts
+#define VSYNC_PHASE_SHIFT  2
+#define VSYNC_PERIOD_SHIFT 5
+//A gap longer than this many periods means vsync was off, not missed
+#define VSYNC_MAX_MISSED   4
 
 int hwc_vsync_control(hwc_context_t* ctx, int dpy, int enable)
 {
@@ -43,15 +51,183 @@ int hwc_vsync_control(hwc_context_t* ctx, int dpy, int enable)
               __FUNCTION__, dpy, enable, strerror(errno));
         ret = -errno;
     }
+
+    //The gap since vsync was turned off is neither missed nor a period
+    if(ret == 0 && enable) {
+        ctx->vstate.tracker[dpy].restart = true;
+        if(dpy == HWC_DISPLAY_PRIMARY)
+            ctx->vstate.tracker[HWC_DISPLAY_EXTERNAL].restart = true;
+    }
+
+    //SF only controls primary vsync, the external one follows it
+    const int extDpy = HWC_DISPLAY_EXTERNAL;
+    if(ret == 0 && dpy == HWC_DISPLAY_PRIMARY && !ctx->vstate.fakevsync &&
+            ctx->dpyAttr[extDpy].connected && isExternalActive(ctx) &&
+            ctx->dpyAttr[extDpy].fd >= 0) {
+        if(ioctl(ctx->dpyAttr[extDpy].fd, MSMFB_OVERLAY_VSYNC_CTRL,
+                 &enable) < 0) {
+            ALOGD("%s: external vsync control failed, enable=%d : %s",
+                  __FUNCTION__, enable, strerror(errno));
+        }
+    }
     return ret;
 }
 
-static void *vsync_loop(void *param)
+//Parses "VSYNC=<nanos>" as written by the driver, 0 if malformed
+static inline uint64_t parse_timestamp(const char *str, ssize_t len)
+{
+    static const char prefix[] = "VSYNC=";
+    const ssize_t prefixLen = sizeof(prefix) - 1;
+    if(len <= prefixLen || memcmp(str, prefix, prefixLen))
+        return 0;
+
+    uint64_t timestamp = 0;
+    for(ssize_t i = prefixLen; i < len; i++) {
+        unsigned int digit = str[i] - '0';
+        if(digit > 9)
+            break;
+        timestamp = timestamp * 10 + digit;
+    }
+    return timestamp;
+}
+
+/* Tracks the vsync phase and period with an alpha-beta filter.
+ * Returns the timestamp to be delivered: the filtered phase if smoothing is
+ * enabled, the raw timestamp otherwise.
+ */
+static uint64_t track_vsync(VsyncTracker& t, uint64_t timestamp,
+        uint64_t nominal, bool smooth)
+{
+    t.count++;
+    if(t.restart || !t.phase || timestamp <= t.phase) {
+        //First event since enable or a clock step, start over
+        t.restart = false;
+        t.phase = timestamp;
+        t.period = nominal;
+        return timestamp;
+    }
+
+    uint64_t elapsed = (timestamp - t.phase + t.period / 2) / t.period;
+    if(!elapsed || elapsed > VSYNC_MAX_MISSED) {
+        //Duplicate event or vsync was just re-enabled
+        t.phase = timestamp;
+        return timestamp;
+    }
+    t.missed += elapsed - 1;
+
+    int64_t predicted = t.phase + elapsed * t.period;
+    int64_t residual = (int64_t)timestamp - predicted;
+    t.phase = predicted + (residual >> VSYNC_PHASE_SHIFT);
+    t.period += (residual / (int64_t)elapsed) >> VSYNC_PERIOD_SHIFT;
+
+    //Keep the estimate within 10% of what the panel reports
+    if(t.period < nominal - nominal / 10 || t.period > nominal + nominal / 10)
+        t.period = nominal;
+
+    return smooth ? t.phase : timestamp;
+}
+
+//Sleeps until the next period boundary of a fixed schedule, so that fake
+//vsync neither drifts nor accumulates wakeup latency.
+static uint64_t wait_fake_vsync(VsyncTracker& t, uint64_t& next,
+        uint64_t period)
+{
+    uint64_t now = systemTime();
+    if(!next)
+        next = now;
+    next += period;
+    if(next <= now) {
+        //Overslept, skip to the next boundary
+        uint64_t skipped = (now - next) / period + 1;
+        t.missed += skipped;
+        next += skipped * period;
+    }
+
+    struct timespec ts;
+    ts.tv_sec = next / 1000000000;
+    ts.tv_nsec = next % 1000000000;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+    t.count++;
+    t.phase = next;
+    t.period = period;
+    return next;
+}
+
+static int open_vsync_event(int fbNum)
 {
-    const char* vsync_timestamp_fb0 = "/sys/class/graphics/fb0/vsync_event";
-    const char* vsync_timestamp_fb1 = "/sys/class/graphics/fb1/vsync_event";
-    int dpy = HWC_DISPLAY_PRIMARY;
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/class/graphics/fb%d/vsync_event",
+             fbNum);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ALOGE ("%s:not able to open file:%s, %s",  __FUNCTION__,
+               path, strerror(errno));
+    }
+    return fd;
+}
+
+static bool is_vsync_target(hwc_context_t *ctx, int dpy)
+{
+    if(!ctx->vstate.enable || !ctx->dpyAttr[dpy].isActive)
+        return false;
+    if(dpy != HWC_DISPLAY_PRIMARY && !ctx->dpyAttr[dpy].connected)
+        return false;
+    return true;
+}
+
+static void handle_vsync_event(hwc_context_t *ctx, int dpy, int fd,
+        bool logvsync)
+{
+    const int MAX_DATA = 64;
+    char vdata[MAX_DATA];
+
+    /* Currently read vsync timestamp from drivers
+       e.g. VSYNC=41800875994
+       */
+    ssize_t len = pread(fd, vdata, MAX_DATA, 0);
+    if (len < 0) {
+        // If the read was just interrupted - it is not a fatal error
+        // In either case, just continue.
+        if (errno != EAGAIN &&
+            errno != EINTR  &&
+            errno != EBUSY) {
+            ALOGE ("FATAL:%s:not able to read vsync event for dpy %d, %s",
+                   __FUNCTION__, dpy, strerror(errno));
+        }
+        return;
+    }
+
+    // extract timestamp
+    uint64_t timestamp = parse_timestamp(vdata, len);
+    if (UNLIKELY(!timestamp))
+        return;
 
+    uint64_t period = ctx->dpyAttr[dpy].vsync_period ?
+            ctx->dpyAttr[dpy].vsync_period : 16666666;
+    uint64_t cur_timestamp = track_vsync(ctx->vstate.tracker[dpy],
+            timestamp, period, ctx->vstate.smooth);
+
+    // send timestamp to HAL
+    if(is_vsync_target(ctx, dpy)) {
+        ALOGD_IF (logvsync, "%s: timestamp %llu sent to HWC for dpy %d",
+                  __FUNCTION__, cur_timestamp, dpy);
+        ctx->proc->vsync(ctx->proc, dpy, cur_timestamp);
+    }
+}
+
+static bool get_log_vsync()
+{
+    char property[PROPERTY_VALUE_MAX];
+    if(property_get("debug.hwc.logvsync", property, 0) > 0) {
+        if(atoi(property) == 1)
+            return true;
+    }
+    return false;
+}
+
+static void *vsync_loop(void *param)
+{
     hwc_context_t * ctx = reinterpret_cast<hwc_context_t *>(param);
 
     char thread_name[64] = HWC_VSYNC_THREAD_NAME;
@@ -59,14 +235,7 @@ static void *vsync_loop(void *param)
     setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY +
                 android::PRIORITY_MORE_FAVORABLE);
 
-    const int MAX_DATA = 64;
-    static char vdata[MAX_DATA];
-
-    uint64_t cur_timestamp=0;
-    ssize_t len = -1;
-    int fd_timestamp = -1;
-    bool fb1_vsync = false;
-    bool logvsync = false;
+    bool logvsync = get_log_vsync();
 
     char property[PROPERTY_VALUE_MAX];
     if(property_get("debug.hwc.fakevsync", property, NULL) > 0) {
@@ -74,59 +243,70 @@ static void *vsync_loop(void *param)
             ctx->vstate.fakevsync = true;
     }
 
-    if(property_get("debug.hwc.logvsync", property, 0) > 0) {
+    //SurfaceFlinger's DispSync already models the hardware vsync, filtering
+    //here as well can put the phase after the real event. Opt-in only.
+    ctx->vstate.smooth = false;
+    if(property_get("debug.hwc.smoothvsync", property, NULL) > 0) {
         if(atoi(property) == 1)
-            logvsync = true;
+            ctx->vstate.smooth = true;
     }
 
-    /* Currently read vsync timestamp from drivers
-       e.g. VSYNC=41800875994
-       */
-    fd_timestamp = open(vsync_timestamp_fb0, O_RDONLY);
-    if (fd_timestamp < 0) {
+    int fd = open_vsync_event(0);
+    if (fd < 0) {
         // Make sure fb device is opened before starting this thread so this
         // never happens.
-        ALOGE ("FATAL:%s:not able to open file:%s, %s",  __FUNCTION__,
-               (fb1_vsync) ? vsync_timestamp_fb1 : vsync_timestamp_fb0,
-               strerror(errno));
         ctx->vstate.fakevsync = true;
     }
 
+    const int dpy = HWC_DISPLAY_PRIMARY;
+    uint64_t next_fake = 0;
+    const uint64_t period = ctx->dpyAttr[dpy].vsync_period ?
+            ctx->dpyAttr[dpy].vsync_period : 16666666;
+
     do {
-        if (LIKELY(!ctx->vstate.fakevsync)) {
-            len = pread(fd_timestamp, vdata, MAX_DATA, 0);
-            if (len < 0) {
-                // If the read was just interrupted - it is not a fatal error
-                // In either case, just continue.
-                if (errno != EAGAIN &&
-                    errno != EINTR  &&
-                    errno != EBUSY) {
-                    ALOGE ("FATAL:%s:not able to read file:%s, %s",
-                           __FUNCTION__,
-                           vsync_timestamp_fb0, strerror(errno));
-                }
-                continue;
-            }
-            // extract timestamp
-            const char *str = vdata;
-            if (!strncmp(str, "VSYNC=", strlen("VSYNC="))) {
-                cur_timestamp = strtoull(str + strlen("VSYNC="), NULL, 0);
+        if (UNLIKELY(ctx->vstate.fakevsync)) {
+            uint64_t cur_timestamp = wait_fake_vsync(ctx->vstate.tracker[dpy],
+                    next_fake, period);
+            if(ctx->vstate.enable) {
+                ALOGD_IF (logvsync, "%s: timestamp %llu sent to HWC for %s",
+                          __FUNCTION__, cur_timestamp, "fb0");
+                ctx->proc->vsync(ctx->proc, dpy, cur_timestamp);
             }
-        } else {
-            usleep(16666);
-            cur_timestamp = systemTime();
-        }
-        // send timestamp to HAL
-        if(ctx->vstate.enable) {
-            ALOGD_IF (logvsync, "%s: timestamp %llu sent to HWC for %s",
-                      __FUNCTION__, cur_timestamp, "fb0");
-            ctx->proc->vsync(ctx->proc, dpy, cur_timestamp);
+            continue;
         }
 
+        // The MDP4 driver blocks the read until the next vsync
+        handle_vsync_event(ctx, dpy, fd, logvsync);
+    } while (true);
+
+    if(fd >= 0)
+        close(fd);
+
+    return NULL;
+}
+
+/* HDMI vsync gets its own thread: the blocking read never returns while no
+ * sink is connected or HDMI vsync is off, which must not hold up primary.
+ */
+static void *ext_vsync_loop(void *param)
+{
+    hwc_context_t * ctx = reinterpret_cast<hwc_context_t *>(param);
+
+    char thread_name[64] = HWC_EXT_VSYNC_THREAD_NAME;
+    prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
+    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY +
+                android::PRIORITY_MORE_FAVORABLE);
+
+    bool logvsync = get_log_vsync();
+    int fd = open_vsync_event(ctx->mExtDisplay->getHdmiFbNum());
+    if (fd < 0)
+        return NULL;
+
+    do {
+        handle_vsync_event(ctx, HWC_DISPLAY_EXTERNAL, fd, logvsync);
     } while (true);
-    if(fd_timestamp >= 0)
-        close (fd_timestamp);
 
+    close(fd);
     return NULL;
 }
 
@@ -140,6 +320,16 @@ void init_vsync_thread(hwc_context_t* ctx)
         ALOGE("%s: failed to create %s: %s", __FUNCTION__,
               HWC_VSYNC_THREAD_NAME, strerror(ret));
     }
+
+    if (ctx->mExtDisplay && ctx->mExtDisplay->getHdmiFbNum() > 0) {
+        pthread_t ext_vsync_thread;
+        ret = pthread_create(&ext_vsync_thread, NULL, ext_vsync_loop,
+                             (void*) ctx);
+        if (ret) {
+            ALOGE("%s: failed to create %s: %s", __FUNCTION__,
+                  HWC_EXT_VSYNC_THREAD_NAME, strerror(ret));
+        }
+    }
 }
 
 }; //namespace
@@ -0,0 +1,27 @@
+LOCAL_PATH := $(call my-dir)
+include $(LOCAL_PATH)/../../common.mk
+include $(CLEAR_VARS)
+
+# Host composition simulator, see hwc_sim.cpp
+LOCAL_MODULE                  := hwcsim
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_STATIC_LIBRARIES        := libutils liblog libcutils
+LOCAL_LDLIBS                  := -lpthread -lrt
+LOCAL_CFLAGS                  := $(common_flags) -DLOG_TAG=\"hwcsim\"
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_SRC_FILES               := hwc_sim.cpp                            \
+                                 sim_mdp.cpp                            \
+                                 sim_rotator.cpp                        \
+                                 sim_target.cpp                         \
+                                 ../hwc_mdpcomp.cpp                     \
+                                 ../hwc_fbupdate.cpp                    \
+                                 ../hwc_layer_utils.cpp                 \
+                                 ../../liboverlay/overlay.cpp           \
+                                 ../../liboverlay/overlayMdp.cpp        \
+                                 ../../liboverlay/overlayRotMgr.cpp     \
+                                 ../../liboverlay/overlayUtils.cpp      \
+                                 ../../liboverlay/pipes/overlayGenPipe.cpp \
+                                 ../../libqdutils/idle_invalidator.cpp
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * hwcsim: replays a layer trace through MDPComp/FBUpdate on the host and
+ * reports the composition chosen for every frame.
+ *
+ * usage: hwcsim [-v] [-s] [-i idle_ms] trace
+ *   -v  MDPComp debug logs
+ *   -s  summary only
+ *   -i  idle timeout, frames arriving later than this after an MDP composed
+ *       frame are composed in idle fallback. Default DEFAULT_IDLE_TIME.
+ *
+ * Trace format, one statement per line, '#' starts a comment:
+ *   target <mdp version> <rgb pipes> <vg pipes> <dma pipes> [video|cmd]
+ *   display <xres> <yres>
+ *   frame <time ms> [geometry]
+ *   layer <buffer> <format> <w> <h> <crop l t r b> <dst l t r b> [options]
+ * target and display must come before the first frame. Layers belong to the
+ * last frame, bottom first; the FB target is added by the simulator. Layers
+ * naming the same buffer share a handle, which is what the layer cache keys
+ * on. Formats: rgba rgbx bgra rgb565 rgb888 nv12 nv21 nv12t yv12.
+ * Options: rot=<hal transform> blend=none|premult|coverage alpha=<0-255>
+ *          skip secure
+ *
+ * traces/ holds sample traces with the output they are expected to give,
+ * a change to the strategy code should keep
+ *   hwcsim traces/video.trace | diff - traces/video.expected
+ * empty, or update the expected output along with it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <overlay.h>
+#include <overlayRotator.h>
+#include <mdp_version.h>
+#include "hwc_utils.h"
+#include "hwc_mdpcomp.h"
+#include "hwc_fbupdate.h"
+#include "hwc_sim.h"
+
+using namespace qhwc;
+using namespace android;
+
+#define MAX_LINE 512
+//Bandwidth is reported for a display refreshing at this rate
+#define REFRESH_RATE 60
+
+namespace hwcsim {
+
+/* Exposes the frame MDPComp decided on */
+class SimMDPComp : public MDPComp {
+public:
+    explicit SimMDPComp(int dpy) : MDPComp(dpy) {}
+    /* Overrides what MDPComp::init() read from the properties */
+    static void setOptions(bool debug) {
+        sEnabled = true;
+        sDebugLogs = debug;
+        //Idle timeouts come from the trace times, see runFrame()
+        idleInvalidator = NULL;
+    }
+    /* What the idle timer does when it fires */
+    static void idleTimeout() { sIdleFallBack = true; }
+    int getMdpCount() const { return mCurrentFrame.mdpCount; }
+    int getFbCount() const { return mCurrentFrame.fbCount; }
+    bool needsRedraw() const { return mCurrentFrame.needsRedraw; }
+};
+
+enum {
+    STRATEGY_MDP,    //all layers on pipes
+    STRATEGY_MIXED,  //pipes + FB, FB redrawn
+    STRATEGY_CACHED, //pipes + FB, FB reused
+    STRATEGY_GLES,   //everything in the FB
+    STRATEGY_IDLE,   //everything in the FB due to idle fallback
+    STRATEGY_MAX,
+};
+
+static const char *sStrategyName[STRATEGY_MAX] = {
+    "MDP", "MIXED", "CACHED", "GLES", "IDLE",
+};
+
+struct Frame {
+    int64_t timeMs;
+    bool geometry;
+    int numLayers;
+    hwc_layer_1_t layers[MAX_NUM_LAYERS];
+};
+
+struct Totals {
+    int frames;
+    int strategy[STRATEGY_MAX];
+    int pipes;
+    int maxPipes;
+    int sets;
+    int unsets;
+    int rotations;
+    uint64_t mdpBytes;
+    uint64_t maxMdpBytes;
+    uint64_t gpuBytes;
+    uint64_t maxGpuBytes;
+};
+
+struct Sim {
+    bool debug;
+    bool summaryOnly;
+    int idleTimeMs;
+    int xres;
+    int yres;
+    hwc_context_t *ctx;
+    private_handle_t *fbHandle;
+    KeyedVector<String8, private_handle_t *> buffers;
+    bool haveLast;
+    int64_t lastTimeMs;
+    int lastMdpCount;
+    Totals totals;
+};
+
+static bool parseFormat(const char *name, int& format, int& type) {
+    static const struct {
+        const char *name;
+        int format;
+        int type;
+    } formats[] = {
+        { "rgba", HAL_PIXEL_FORMAT_RGBA_8888, BUFFER_TYPE_UI },
+        { "rgbx", HAL_PIXEL_FORMAT_RGBX_8888, BUFFER_TYPE_UI },
+        { "bgra", HAL_PIXEL_FORMAT_BGRA_8888, BUFFER_TYPE_UI },
+        { "rgb565", HAL_PIXEL_FORMAT_RGB_565, BUFFER_TYPE_UI },
+        { "rgb888", HAL_PIXEL_FORMAT_RGB_888, BUFFER_TYPE_UI },
+        { "nv12", HAL_PIXEL_FORMAT_YCbCr_420_SP, BUFFER_TYPE_VIDEO },
+        { "nv21", HAL_PIXEL_FORMAT_YCrCb_420_SP, BUFFER_TYPE_VIDEO },
+        { "nv12t", HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED, BUFFER_TYPE_VIDEO },
+        { "yv12", HAL_PIXEL_FORMAT_YV12, BUFFER_TYPE_VIDEO },
+    };
+    for(size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if(!strcmp(name, formats[i].name)) {
+            format = formats[i].format;
+            type = formats[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+static private_handle_t *newHandle(int format, int type, int w, int h,
+        int flags) {
+    int size = w * h * getBitsPerPixel(format) / 8;
+    return new private_handle_t(-1, size, flags, type, format, w, h);
+}
+
+static bool parseInts(char **save, int *vals, int count) {
+    for(int i = 0; i < count; i++) {
+        char *tok = strtok_r(NULL, " \t", save);
+        if(!tok)
+            return false;
+        vals[i] = atoi(tok);
+    }
+    return true;
+}
+
+static bool parseLayer(Sim& sim, char **save, hwc_layer_1_t& layer) {
+    char *buffer = strtok_r(NULL, " \t", save);
+    char *fmt = strtok_r(NULL, " \t", save);
+    int format, type;
+    int v[10];
+    if(!buffer || !fmt || !parseFormat(fmt, format, type) ||
+            !parseInts(save, v, 10))
+        return false;
+
+    memset(&layer, 0, sizeof(layer));
+    layer.compositionType = HWC_FRAMEBUFFER;
+    layer.blending = HWC_BLENDING_PREMULT;
+    layer.planeAlpha = 0xFF;
+    layer.acquireFenceFd = -1;
+    layer.releaseFenceFd = -1;
+    layer.sourceCrop.left = v[2];
+    layer.sourceCrop.top = v[3];
+    layer.sourceCrop.right = v[4];
+    layer.sourceCrop.bottom = v[5];
+    layer.displayFrame.left = v[6];
+    layer.displayFrame.top = v[7];
+    layer.displayFrame.right = v[8];
+    layer.displayFrame.bottom = v[9];
+
+    int flags = 0;
+    char *tok;
+    while((tok = strtok_r(NULL, " \t", save))) {
+        if(!strncmp(tok, "rot=", 4)) {
+            layer.transform = atoi(tok + 4);
+        } else if(!strcmp(tok, "blend=none")) {
+            layer.blending = HWC_BLENDING_NONE;
+        } else if(!strcmp(tok, "blend=premult")) {
+            layer.blending = HWC_BLENDING_PREMULT;
+        } else if(!strcmp(tok, "blend=coverage")) {
+            layer.blending = HWC_BLENDING_COVERAGE;
+        } else if(!strncmp(tok, "alpha=", 6)) {
+            layer.planeAlpha = atoi(tok + 6);
+        } else if(!strcmp(tok, "skip")) {
+            layer.flags |= HWC_SKIP_LAYER;
+        } else if(!strcmp(tok, "secure")) {
+            flags |= private_handle_t::PRIV_FLAGS_SECURE_BUFFER;
+        } else {
+            return false;
+        }
+    }
+
+    String8 name(buffer);
+    ssize_t index = sim.buffers.indexOfKey(name);
+    if(index < 0) {
+        private_handle_t *hnd = newHandle(format, type, v[0], v[1], flags);
+        index = sim.buffers.add(name, hnd);
+    }
+    layer.handle = sim.buffers.valueAt(index);
+    return true;
+}
+
+static void createContext(Sim& sim) {
+    hwc_context_t *ctx = (hwc_context_t*)malloc(sizeof(*ctx));
+    memset(ctx, 0, sizeof(*ctx));
+
+    DisplayAttributes& attr = ctx->dpyAttr[HWC_DISPLAY_PRIMARY];
+    attr.xres = sim.xres;
+    attr.yres = sim.yres;
+    attr.stride = sim.xres * 4;
+    attr.vsync_period = 1000000000 / REFRESH_RATE;
+    attr.fd = -1;
+    attr.isActive = true;
+    attr.connected = true;
+
+    overlay::Overlay::initOverlay();
+    ctx->mOverlay = overlay::Overlay::getInstance();
+    ctx->mRotMgr = new overlay::RotMgr();
+    ctx->mLayerRotMap[HWC_DISPLAY_PRIMARY] = new LayerRotMap();
+    ctx->mMDP.version = qdutils::MDPVersion::getInstance().getMDPVersion();
+    ctx->mMDP.hasOverlay = qdutils::MDPVersion::getInstance().hasOverlay();
+    ctx->mMDP.panel = qdutils::MDPVersion::getInstance().getPanelType();
+    ctx->mFBUpdate[HWC_DISPLAY_PRIMARY] =
+        IFBUpdate::getObject(sim.xres, HWC_DISPLAY_PRIMARY);
+    ctx->mMDPComp[HWC_DISPLAY_PRIMARY] = new SimMDPComp(HWC_DISPLAY_PRIMARY);
+    MDPComp::init(ctx);
+    SimMDPComp::setOptions(sim.debug);
+    //The base pipe is a border fill ioctl, nothing to simulate
+    ctx->mBasePipeSetup = true;
+
+    sim.fbHandle = newHandle(HAL_PIXEL_FORMAT_RGBA_8888, BUFFER_TYPE_UI,
+            sim.xres, sim.yres, private_handle_t::PRIV_FLAGS_FRAMEBUFFER);
+    sim.ctx = ctx;
+}
+
+static uint64_t layerBytes(const hwc_layer_1_t& layer) {
+    private_handle_t *hnd = (private_handle_t *)layer.handle;
+    uint64_t w = layer.sourceCrop.right - layer.sourceCrop.left;
+    uint64_t h = layer.sourceCrop.bottom - layer.sourceCrop.top;
+    return w * h * getBitsPerPixel(hnd->format) / 8;
+}
+
+static double toMBps(uint64_t bytesPerFrame) {
+    return (double)bytesPerFrame * REFRESH_RATE / (1024.0 * 1024.0);
+}
+
+/* Same sequence hwc_prepare()/hwc_set() run for the primary display */
+static void runFrame(Sim& sim, Frame& frame) {
+    hwc_context_t *ctx = sim.ctx;
+    const int dpy = HWC_DISPLAY_PRIMARY;
+    const int numHwLayers = frame.numLayers + 1;
+
+    size_t size = sizeof(hwc_display_contents_1_t) +
+            numHwLayers * sizeof(hwc_layer_1_t);
+    hwc_display_contents_1_t *list = (hwc_display_contents_1_t*)malloc(size);
+    memset(list, 0, size);
+    list->retireFenceFd = -1;
+    list->flags = frame.geometry ? HWC_GEOMETRY_CHANGED : 0;
+    list->numHwLayers = numHwLayers;
+    memcpy(list->hwLayers, frame.layers,
+            frame.numLayers * sizeof(hwc_layer_1_t));
+
+    hwc_layer_1_t& fbLayer = list->hwLayers[frame.numLayers];
+    fbLayer.compositionType = HWC_FRAMEBUFFER_TARGET;
+    fbLayer.handle = sim.fbHandle;
+    fbLayer.blending = HWC_BLENDING_PREMULT;
+    fbLayer.planeAlpha = 0xFF;
+    fbLayer.acquireFenceFd = -1;
+    fbLayer.releaseFenceFd = -1;
+    fbLayer.sourceCrop.right = fbLayer.displayFrame.right = sim.xres;
+    fbLayer.sourceCrop.bottom = fbLayer.displayFrame.bottom = sim.yres;
+
+    //Idle timer would have fired between the two frames
+    bool idle = sim.haveLast && sim.lastMdpCount &&
+            frame.timeMs - sim.lastTimeMs >= sim.idleTimeMs;
+    if(idle)
+        SimMDPComp::idleTimeout();
+
+    //prepare
+    beginRound();
+    ctx->mFBUpdate[dpy]->reset();
+    ctx->mOverlay->configBegin();
+    ctx->mRotMgr->configBegin();
+    ctx->mLayerRotMap[dpy]->reset();
+    ctx->mNeedsRotator = false;
+    delete[] ctx->layerProp[dpy];
+    ctx->layerProp[dpy] = new LayerProp[frame.numLayers];
+    setListStats(ctx, list, dpy);
+    SimMDPComp *mdpComp = (SimMDPComp *)ctx->mMDPComp[dpy];
+    int ret = mdpComp->prepare(ctx, list);
+    if(ret < 0)
+        ctx->mFBUpdate[dpy]->prepare(ctx, list, 0);
+    ctx->mOverlay->configDone();
+    ctx->mRotMgr->configDone();
+
+    //set
+    if(!mdpComp->draw(ctx, list))
+        fprintf(stderr, "frame %d: MDPComp draw failed\n", sim.totals.frames);
+    if(!ctx->mFBUpdate[dpy]->draw(ctx, (private_handle_t *)fbLayer.handle))
+        fprintf(stderr, "frame %d: FBUpdate draw failed\n", sim.totals.frames);
+    MDPComp::resetIdleFallBack();
+    ctx->mVideoTransFlag = false;
+
+    int strategy;
+    if(ret < 0)
+        strategy = idle ? STRATEGY_IDLE : STRATEGY_GLES;
+    else if(!mdpComp->getFbCount())
+        strategy = STRATEGY_MDP;
+    else if(mdpComp->needsRedraw())
+        strategy = STRATEGY_MIXED;
+    else
+        strategy = STRATEGY_CACHED;
+
+    //GPU reads what is left to it and writes the whole FB target
+    uint64_t gpuBytes = 0;
+    for(int i = 0; i < frame.numLayers; i++) {
+        if(list->hwLayers[i].compositionType == HWC_FRAMEBUFFER)
+            gpuBytes += layerBytes(list->hwLayers[i]);
+    }
+    if(gpuBytes)
+        gpuBytes += layerBytes(fbLayer);
+
+    RoundStats round;
+    getRoundStats(round);
+    int pipes = 0;
+    for(int i = 0; i < ovutils::OV_MDP_PIPE_ANY; i++)
+        pipes += round.pipes[i];
+
+    Totals& t = sim.totals;
+    t.frames++;
+    t.strategy[strategy]++;
+    t.pipes += pipes;
+    t.maxPipes = max(t.maxPipes, pipes);
+    t.sets += round.sets;
+    t.unsets += round.unsets;
+    t.rotations += round.rotations;
+    t.mdpBytes += round.fetchBytes;
+    t.maxMdpBytes = max(t.maxMdpBytes, round.fetchBytes);
+    t.gpuBytes += gpuBytes;
+    t.maxGpuBytes = max(t.maxGpuBytes, gpuBytes);
+
+    if(!sim.summaryOnly) {
+        printf("%5d %8lldms %-6s layers %2d mdp %2d fb %2d | "
+               "rgb %d vg %d dma %d | set %d unset %d rot %d | "
+               "mdp %7.1fMB/s gpu %7.1fMB/s\n",
+               t.frames - 1, (long long)frame.timeMs,
+               sStrategyName[strategy], frame.numLayers,
+               ret < 0 ? 0 : mdpComp->getMdpCount(),
+               ret < 0 ? frame.numLayers : mdpComp->getFbCount(),
+               round.pipes[ovutils::OV_MDP_PIPE_RGB],
+               round.pipes[ovutils::OV_MDP_PIPE_VG],
+               round.pipes[ovutils::OV_MDP_PIPE_DMA],
+               round.sets, round.unsets, round.rotations,
+               toMBps(round.fetchBytes), toMBps(gpuBytes));
+    }
+
+    sim.haveLast = true;
+    sim.lastTimeMs = frame.timeMs;
+    sim.lastMdpCount = ret < 0 ? 0 : mdpComp->getMdpCount();
+    free(list);
+}
+
+static void printSummary(const Sim& sim) {
+    const Totals& t = sim.totals;
+    if(!t.frames) {
+        printf("no frames\n");
+        return;
+    }
+    printf("\nframes: %d\n", t.frames);
+    for(int i = 0; i < STRATEGY_MAX; i++) {
+        printf("  %-6s %6d (%5.1f%%)\n", sStrategyName[i], t.strategy[i],
+               100.0 * t.strategy[i] / t.frames);
+    }
+    printf("pipes: avg %.2f max %d\n", (double)t.pipes / t.frames,
+           t.maxPipes);
+    printf("ioctls: set %d unset %d, rotator passes %d\n",
+           t.sets, t.unsets, t.rotations);
+    printf("bandwidth at %dfps: mdp avg %.1fMB/s max %.1fMB/s, "
+           "gpu avg %.1fMB/s max %.1fMB/s\n", REFRESH_RATE,
+           toMBps(t.mdpBytes / t.frames), toMBps(t.maxMdpBytes),
+           toMBps(t.gpuBytes / t.frames), toMBps(t.maxGpuBytes));
+}
+
+static int replay(Sim& sim, FILE *fp, const char *path) {
+    char line[MAX_LINE];
+    int lineNum = 0;
+    Frame *frame = new Frame;
+    bool inFrame = false;
+
+    while(fgets(line, sizeof(line), fp)) {
+        lineNum++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *comment = strchr(line, '#');
+        if(comment)
+            *comment = '\0';
+        char *save = NULL;
+        char *cmd = strtok_r(line, " \t", &save);
+        if(!cmd)
+            continue;
+
+        bool ok = true;
+        if(!strcmp(cmd, "target") && !sim.ctx) {
+            int v[4];
+            ok = parseInts(&save, v, 4);
+            gTarget.mdpVersion = v[0];
+            gTarget.rgbPipes = v[1];
+            gTarget.vgPipes = v[2];
+            gTarget.dmaPipes = v[3];
+            char *panel = strtok_r(NULL, " \t", &save);
+            if(panel)
+                gTarget.panel = strcmp(panel, "cmd") ? MIPI_VIDEO_PANEL :
+                        MIPI_CMD_PANEL;
+        } else if(!strcmp(cmd, "display") && !sim.ctx) {
+            int v[2];
+            ok = parseInts(&save, v, 2);
+            sim.xres = v[0];
+            sim.yres = v[1];
+        } else if(!strcmp(cmd, "frame")) {
+            if(inFrame)
+                runFrame(sim, *frame);
+            if(!sim.ctx)
+                createContext(sim);
+            char *tok = strtok_r(NULL, " \t", &save);
+            ok = (tok != NULL);
+            frame->timeMs = tok ? atoll(tok) : 0;
+            tok = strtok_r(NULL, " \t", &save);
+            frame->geometry = tok && !strcmp(tok, "geometry");
+            frame->numLayers = 0;
+            inFrame = true;
+        } else if(!strcmp(cmd, "layer") && inFrame &&
+                frame->numLayers < MAX_NUM_LAYERS - 1) {
+            ok = parseLayer(sim, &save, frame->layers[frame->numLayers++]);
+        } else {
+            ok = false;
+        }
+
+        if(!ok) {
+            fprintf(stderr, "%s:%d: bad statement\n", path, lineNum);
+            delete frame;
+            return -1;
+        }
+    }
+    if(inFrame)
+        runFrame(sim, *frame);
+    delete frame;
+    return 0;
+}
+
+}; //namespace hwcsim
+
+using namespace hwcsim;
+
+int main(int argc, char **argv) {
+    Sim sim;
+    memset(&sim.totals, 0, sizeof(sim.totals));
+    sim.debug = false;
+    sim.summaryOnly = false;
+    sim.idleTimeMs = DEFAULT_IDLE_TIME;
+    sim.xres = 1280;
+    sim.yres = 720;
+    sim.ctx = NULL;
+    sim.fbHandle = NULL;
+    sim.haveLast = false;
+    sim.lastTimeMs = 0;
+    sim.lastMdpCount = 0;
+
+    int opt;
+    while((opt = getopt(argc, argv, "vsi:")) != -1) {
+        switch(opt) {
+        case 'v':
+            sim.debug = true;
+            break;
+        case 's':
+            sim.summaryOnly = true;
+            break;
+        case 'i':
+            sim.idleTimeMs = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [-s] [-i idle_ms] trace\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if(optind >= argc) {
+        fprintf(stderr, "usage: %s [-v] [-s] [-i idle_ms] trace\n", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    FILE *fp = fopen(path, "r");
+    if(!fp) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    int ret = replay(sim, fp, path);
+    fclose(fp);
+    if(ret < 0)
+        return 1;
+
+    printSummary(sim);
+    return 0;
+}
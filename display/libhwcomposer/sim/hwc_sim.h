@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HWC_SIM_H
+#define HWC_SIM_H
+
+#include <stdint.h>
+#include <overlayUtils.h>
+
+/* Host side composition simulator. The strategy code (MDPComp, FBUpdate and
+ * the layer helpers) and liboverlay's pipe and rotator session books are
+ * built as is, the MDP ioctls, rotator device and target are replaced by the
+ * mocks in sim_mdp.cpp, sim_rotator.cpp and sim_target.cpp. */
+namespace hwcsim {
+
+/* Target the mocks pretend to be. Set before the context is created. */
+struct Target {
+    int mdpVersion;
+    char panel;
+    int rgbPipes;
+    int vgPipes;
+    int dmaPipes;
+};
+extern Target gTarget;
+
+/* What the mock MDP saw since beginRound() */
+struct RoundStats {
+    /* played pipes, per ovutils::eMdpPipeType */
+    int pipes[overlay::utils::OV_MDP_PIPE_ANY];
+    /* OVERLAY_SET ioctls, i.e. pipes whose config changed */
+    int sets;
+    /* OVERLAY_UNSET ioctls, i.e. pipes released */
+    int unsets;
+    /* layers that went through the rotator */
+    int rotations;
+    /* bytes the MDP fetches for one refresh, rotator traffic included */
+    uint64_t fetchBytes;
+};
+
+/* Starts counting a new prepare/set round */
+void beginRound();
+/* Returns the stats of the current round */
+void getRoundStats(RoundStats& stats);
+/* Counts a rotator session for the current round */
+void addRotation(uint64_t bytes);
+/* Bits per pixel of a HAL format, for bandwidth estimates */
+int getBitsPerPixel(int halFormat);
+
+}; //namespace hwcsim
+
+#endif //HWC_SIM_H
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* liboverlay/mdpWrapper.cpp for the host. The framebuffer nodes are
+ * /dev/null and the MDP only remembers the pipe configs it is given, to count
+ * ioctls and the bandwidth of the pipes played each round. */
+
+#include <mdpWrapper.h>
+#include "hwc_sim.h"
+
+namespace hwcsim {
+
+static RoundStats sRound;
+
+void beginRound() {
+    memset(&sRound, 0, sizeof(sRound));
+}
+
+void getRoundStats(RoundStats& stats) {
+    stats = sRound;
+}
+
+void addRotation(uint64_t bytes) {
+    sRound.rotations++;
+    sRound.fetchBytes += bytes;
+}
+
+int getBitsPerPixel(int halFormat) {
+    switch(halFormat) {
+    case HAL_PIXEL_FORMAT_RGB_565:
+        return 16;
+    case HAL_PIXEL_FORMAT_RGB_888:
+        return 24;
+    case HAL_PIXEL_FORMAT_YV12:
+    case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP_TILED:
+    case HAL_PIXEL_FORMAT_YCbCr_420_SP_VENUS:
+        return 12;
+    case HAL_PIXEL_FORMAT_YCbCr_422_SP:
+    case HAL_PIXEL_FORMAT_YCrCb_422_SP:
+        return 16;
+    case HAL_PIXEL_FORMAT_YCbCr_444_SP:
+    case HAL_PIXEL_FORMAT_YCrCb_444_SP:
+        return 24;
+    default:
+        return 32;
+    }
+}
+
+}; //namespace hwcsim
+
+namespace overlay {
+using namespace utils;
+
+bool open(OvFD& fd, uint32_t fbnum, const char* const dev, int flags)
+{
+    return fd.open("/dev/null", flags);
+}
+
+namespace mdp_wrapper {
+
+IoctlCount gIoctlCount = {0, 0, 0};
+
+/* Pipes set up on the MDP, id is index + 1 */
+static mdp_overlay sPipes[OV_MAX];
+static bool sPipeSet[OV_MAX];
+
+static mdp_overlay* findPipe(int id) {
+    if(id < 1 || id > OV_MAX || !sPipeSet[id - 1])
+        return NULL;
+    return &sPipes[id - 1];
+}
+
+//No framebuffer to query on the host
+bool getFScreenInfo(int fd, fb_fix_screeninfo& finfo) {
+    return false;
+}
+
+bool getVScreenInfo(int fd, fb_var_screeninfo& vinfo) {
+    return false;
+}
+
+bool setVScreenInfo(int fd, fb_var_screeninfo& vinfo) {
+    return false;
+}
+
+//Rotator sessions are mocked in sim_rotator.cpp and never get here
+bool startRotator(int fd, msm_rotator_img_info& rot) {
+    return false;
+}
+
+bool rotate(int fd, msm_rotator_data_info& rot) {
+    return false;
+}
+
+bool endRotator(int fd, uint32_t sessionId) {
+    return false;
+}
+
+bool setOverlay(int fd, mdp_overlay& ov) {
+    gIoctlCount.set++;
+    int index = (int)ov.id - 1;
+    if(MSMFB_NEW_REQUEST == static_cast<int>(ov.id)) {
+        for(index = 0; index < OV_MAX && sPipeSet[index]; index++);
+        if(index == OV_MAX)
+            return false;
+        ov.id = index + 1;
+    } else if(!findPipe(ov.id)) {
+        return false;
+    }
+    sPipes[index] = ov;
+    sPipeSet[index] = true;
+    hwcsim::sRound.sets++;
+    return true;
+}
+
+bool unsetOverlay(int fd, int ovId) {
+    gIoctlCount.unset++;
+    if(!findPipe(ovId))
+        return false;
+    sPipeSet[ovId - 1] = false;
+    hwcsim::sRound.unsets++;
+    return true;
+}
+
+bool getOverlay(int fd, mdp_overlay& ov) {
+    mdp_overlay *pipe = findPipe(ov.id);
+    if(!pipe)
+        return false;
+    ov = *pipe;
+    return true;
+}
+
+/* Charges one refresh of the pipe. The pipe type is picked the way MDP4
+ * allocates pipes: DMA when forced, VG when shared or for YUV, else RGB. */
+bool play(int fd, msmfb_overlay_data& od) {
+    gIoctlCount.play++;
+    mdp_overlay *pipe = findPipe(od.id);
+    if(!pipe)
+        return false;
+    eMdpPipeType type = OV_MDP_PIPE_RGB;
+    if(pipe->flags & MDP_OV_PIPE_FORCE_DMA)
+        type = OV_MDP_PIPE_DMA;
+    else if((pipe->flags & MDP_OV_PIPE_SHARE) || isYuv(pipe->src.format))
+        type = OV_MDP_PIPE_VG;
+    hwcsim::sRound.pipes[type]++;
+
+    int bpp = hwcsim::getBitsPerPixel(getHALFormat(pipe->src.format));
+    hwcsim::sRound.fetchBytes +=
+            (uint64_t)pipe->src_rect.w * pipe->src_rect.h * bpp / 8;
+    return true;
+}
+
+bool set3D(int fd, msmfb_overlay_3d& ov) {
+    return false;
+}
+
+//Mixers start out empty
+bool getMixerInfo(int fd, msmfb_mixer_info_req& req) {
+    req.cnt = 0;
+    return true;
+}
+
+} // mdp_wrapper
+
+}; // namespace overlay
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* The rotator device parts of liboverlay/overlayRotator.cpp. RotMgr hands
+ * out these sessions as on the target, a commit only charges the rotator
+ * pass to the round. */
+
+#include <overlayRotator.h>
+#include "hwc_sim.h"
+
+namespace overlay {
+using namespace utils;
+
+/* Stands in for MdpRot */
+class SimRot : public Rotator {
+public:
+    SimRot() : mFlags(OV_MDP_FLAGS_NONE), mTransform(OVERLAY_TRANSFORM_0),
+            mDownscale(0) {}
+    virtual ~SimRot() {}
+    virtual void setSource(const Whf& whf) { mWhf = whf; }
+    virtual void setSource(const Whf& awhf, const Whf& owhf) {
+        mWhf = awhf;
+    }
+    virtual void setFlags(const eMdpFlags& flags) { mFlags = flags; }
+    virtual void setTransform(const eTransform& rot) { mTransform = rot; }
+    /* Reads the whole source and writes it back downscaled */
+    virtual bool commit() {
+        uint64_t src = (uint64_t)mWhf.w * mWhf.h *
+                hwcsim::getBitsPerPixel(getHALFormat(mWhf.format)) / 8;
+        uint64_t dst = src >> (2 * mDownscale);
+        hwcsim::addRotation(src + dst);
+        return true;
+    }
+    virtual void setDownscale(int ds) { mDownscale = ds; }
+    virtual int getDstMemId() const { return -1; }
+    virtual uint32_t getDstOffset() const { return 0; }
+    //No fast YUV on the host, the output keeps the source format
+    virtual uint32_t getDstFormat() const { return mWhf.format; }
+    virtual uint32_t getSessId() const { return 0; }
+    virtual bool queueBuffer(int fd, uint32_t offset) { return true; }
+    virtual void dump() const {}
+    virtual void getDump(char *buf, size_t len) const {}
+private:
+    Whf mWhf;
+    eMdpFlags mFlags;
+    eTransform mTransform;
+    int mDownscale;
+};
+
+Rotator::~Rotator() {}
+
+Rotator* Rotator::getRotator() {
+    return new SimRot();
+}
+
+//Rotator buffers are never allocated on the host
+RotMem::Mem::Mem() : mCurrOffset(0) {
+    utils::memset0(mRotOffset);
+    for(int i = 0; i < ROT_NUM_BUFS; i++) {
+        mRelFence[i] = -1;
+    }
+}
+
+RotMem::Mem::~Mem() {}
+
+bool RotMem::Mem::close() { return true; }
+
+void RotMem::Mem::setReleaseFd(const int& fence) {}
+
+bool RotMem::close() { return true; }
+
+//No rotator device on the host, SimRot does not need it
+int RotMgr::getRotDevFd() {
+    return -1;
+}
+
+} //namespace overlay
+
+namespace gralloc {
+
+//OvMem asks for the allocator up front, it is never used on the host
+IAllocController* IAllocController::getInstance(void) {
+    return NULL;
+}
+
+} //namespace gralloc
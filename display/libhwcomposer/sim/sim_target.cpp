@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host versions of the parts of hwc_utils.cpp and libqdutils that talk to
+ * the framebuffer or pp daemon. */
+
+#include <overlay.h>
+#include <mdp_version.h>
+#include "hwc_utils.h"
+#include "hwc_sim.h"
+
+namespace android {
+ANDROID_SINGLETON_STATIC_INSTANCE(qdutils::MDPVersion);
+}
+
+namespace hwcsim {
+Target gTarget = { qdutils::MDP_V4_2, MIPI_VIDEO_PANEL, 2, 2, 0 };
+};
+
+namespace qdutils {
+
+MDPVersion::MDPVersion()
+{
+    mMDPVersion = hwcsim::gTarget.mdpVersion;
+    mPanelType = hwcsim::gTarget.panel;
+    mHasOverlay = true;
+    mMdpRev = 0;
+    mRGBPipes = hwcsim::gTarget.rgbPipes;
+    mVGPipes = hwcsim::gTarget.vgPipes;
+    mDMAPipes = hwcsim::gTarget.dmaPipes;
+}
+
+}; //namespace qdutils
+
+namespace qhwc {
+
+using namespace overlay;
+using namespace overlay::utils;
+
+//No pp daemon on the host
+void configurePPD(hwc_context_t *ctx, int yuvCount) {
+}
+
+//Action safe only applies to external displays, which are not simulated
+void getActionSafePosition(hwc_context_t *ctx, int dpy, uint32_t& x,
+                           uint32_t& y, uint32_t& w, uint32_t& h) {
+}
+
+}; //namespace qhwc
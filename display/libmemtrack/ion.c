@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hardware/memtrack.h>
+
+#include "memtrack_msm.h"
+
+#define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
+#define min(x, y) ((x) < (y) ? (x) : (y))
+
+#define ION_DEBUG_DIR "/d/ion"
+
+/* ION heaps reported per process, by their debugfs name */
+static const struct {
+    const char *name;
+    enum memtrack_type type;
+} ion_heaps[] = {
+    { "mm", MEMTRACK_TYPE_MULTIMEDIA },
+    { "audio", MEMTRACK_TYPE_MULTIMEDIA },
+    { "camera_preview", MEMTRACK_TYPE_CAMERA },
+};
+
+static struct memtrack_record ion_record_templates[] = {
+    {
+        .flags = MEMTRACK_FLAG_SMAPS_UNACCOUNTED |
+                 MEMTRACK_FLAG_SHARED,
+    },
+};
+
+struct ion_usage {
+    pid_t pid;
+    size_t multimedia;
+    size_t camera;
+};
+
+static struct ion_usage *usage_cache;
+static size_t usage_count;
+static size_t usage_size;
+static uint64_t usage_time;
+static bool usage_valid;
+static pthread_mutex_t usage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct ion_usage *ion_find_usage(pid_t pid, bool create)
+{
+    size_t i;
+
+    for (i = 0; i < usage_count; i++) {
+        if (usage_cache[i].pid == pid)
+            return &usage_cache[i];
+    }
+    if (!create)
+        return NULL;
+
+    if (usage_count == usage_size) {
+        size_t size = usage_size ? usage_size * 2 : 64;
+        struct ion_usage *cache = realloc(usage_cache, size * sizeof(*cache));
+        if (cache == NULL)
+            return NULL;
+        usage_cache = cache;
+        usage_size = size;
+    }
+    memset(&usage_cache[usage_count], 0, sizeof(*usage_cache));
+    usage_cache[usage_count].pid = pid;
+    return &usage_cache[usage_count++];
+}
+
+/* Each heap lists the memory its clients hold:
+ *           client              pid             size
+ *   surfaceflinger              183         12595200
+ * The client name may contain spaces, pid and size are the last tokens.
+ */
+static void ion_parse_heap(const char *name, enum memtrack_type type)
+{
+    FILE *fp;
+    char line[256];
+
+    snprintf(line, sizeof(line), ION_DEBUG_DIR "/%s", name);
+    fp = fopen(line, "r");
+    if (fp == NULL)
+        return;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        struct memtrack_token tokens[8];
+        struct ion_usage *usage;
+        unsigned long pid, size;
+        size_t count;
+
+        count = memtrack_tokenize(line, tokens, ARRAY_SIZE(tokens));
+        if (count < 3 ||
+            !memtrack_token_to_ulong(&tokens[count - 2], &pid) ||
+            !memtrack_token_to_ulong(&tokens[count - 1], &size) ||
+            pid == 0) {
+            continue;
+        }
+
+        usage = ion_find_usage((pid_t)pid, true);
+        if (usage == NULL)
+            break;
+        if (type == MEMTRACK_TYPE_CAMERA)
+            usage->camera += size;
+        else
+            usage->multimedia += size;
+    }
+
+    fclose(fp);
+}
+
+static void ion_refresh_usage(void)
+{
+    size_t i;
+
+    usage_count = 0;
+    usage_time = memtrack_now_ms();
+    usage_valid = true;
+
+    for (i = 0; i < ARRAY_SIZE(ion_heaps); i++)
+        ion_parse_heap(ion_heaps[i].name, ion_heaps[i].type);
+}
+
+int ion_memtrack_get_memory(pid_t pid, enum memtrack_type type,
+                            struct memtrack_record *records,
+                            size_t *num_records)
+{
+    size_t allocated_records = min(*num_records,
+                                   ARRAY_SIZE(ion_record_templates));
+    struct ion_usage *usage;
+    size_t size = 0;
+
+    *num_records = ARRAY_SIZE(ion_record_templates);
+
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0) {
+        return 0;
+    }
+
+    memcpy(records, ion_record_templates,
+           sizeof(struct memtrack_record) * allocated_records);
+
+    pthread_mutex_lock(&usage_lock);
+    if (!usage_valid ||
+        memtrack_now_ms() - usage_time > MEMTRACK_CACHE_TTL_MS) {
+        ion_refresh_usage();
+    }
+    usage = ion_find_usage(pid, false);
+    if (usage != NULL)
+        size = (type == MEMTRACK_TYPE_CAMERA) ? usage->camera
+                                              : usage->multimedia;
+    pthread_mutex_unlock(&usage_lock);
+
+    records[0].size_in_bytes = size;
+
+    return 0;
+}
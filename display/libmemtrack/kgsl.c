@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 
@@ -27,6 +30,8 @@
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
+#define KGSL_PROC_DIR "/d/kgsl/proc"
+
 struct memtrack_record record_templates[] = {
     {
         .flags = MEMTRACK_FLAG_SMAPS_ACCOUNTED |
@@ -40,79 +45,197 @@ struct memtrack_record record_templates[] = {
     },
 };
 
-int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
-                             struct memtrack_record *records,
-                             size_t *num_records)
+struct kgsl_usage {
+    pid_t pid;
+    size_t gl_accounted;
+    size_t gl_unaccounted;
+    size_t ion;
+    /* Part of ion used for egl images, not counted for surfaceflinger */
+    size_t ion_egl_image;
+};
+
+static struct kgsl_usage *usage_cache;
+static size_t usage_count;
+static size_t usage_size;
+static uint64_t usage_time;
+static bool usage_valid;
+static pthread_mutex_t usage_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Go through each line of <pid>/mem file and for every entry of type "gpumem"
+ * check if the gpubuffer entry is usermapped or not. If the entry is usermapped
+ * count the entry as accounted else count the entry as unaccounted.
+ */
+static int kgsl_parse_mem(pid_t pid, struct kgsl_usage *usage)
 {
-    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
     FILE *fp;
     char line[1024];
-    char tmp[128];
-    bool is_surfaceflinger = false;
-    size_t accounted_size = 0;
-    size_t unaccounted_size = 0;
 
-    *num_records = ARRAY_SIZE(record_templates);
+    snprintf(line, sizeof(line), KGSL_PROC_DIR "/%d/mem", pid);
+    fp = fopen(line, "r");
+    if (fp == NULL) {
+        return -errno;
+    }
 
-    /* fastpath to return the necessary number of records */
-    if (allocated_records == 0) {
-        return 0;
+    memset(usage, 0, sizeof(*usage));
+    usage->pid = pid;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        struct memtrack_token tokens[8];
+        unsigned long size;
+
+        /* Format:
+         *  gpuaddr useraddr     size    id flags       type            usage sglen
+         * 545ba000 545ba000     4096     1 ----pY     gpumem      arraybuffer     1
+         */
+        if (memtrack_tokenize(line, tokens, ARRAY_SIZE(tokens)) < 7 ||
+            !memtrack_token_to_ulong(&tokens[2], &size)) {
+            continue;
+        }
+
+        if (memtrack_token_equals(&tokens[5], "gpumem")) {
+            if (tokens[4].len > 5 && tokens[4].str[5] == 'Y')
+                usage->gl_accounted += size;
+            else
+                usage->gl_unaccounted += size;
+        } else if (memtrack_token_equals(&tokens[5], "ion")) {
+            usage->ion += size;
+            if (memtrack_token_equals(&tokens[6], "egl_image"))
+                usage->ion_egl_image += size;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+static struct kgsl_usage *kgsl_add_usage(void)
+{
+    if (usage_count == usage_size) {
+        size_t size = usage_size ? usage_size * 2 : 64;
+        struct kgsl_usage *cache = realloc(usage_cache,
+                                           size * sizeof(*cache));
+        if (cache == NULL)
+            return NULL;
+        usage_cache = cache;
+        usage_size = size;
+    }
+    return &usage_cache[usage_count++];
+}
+
+/* Collect the usage of every process known to KGSL in one walk */
+static void kgsl_refresh_usage(void)
+{
+    DIR *dir;
+    struct dirent *entry;
+
+    usage_count = 0;
+    usage_time = memtrack_now_ms();
+    usage_valid = true;
+
+    dir = opendir(KGSL_PROC_DIR);
+    if (dir == NULL)
+        return;
+
+    while ((entry = readdir(dir)) != NULL) {
+        struct memtrack_token token = { entry->d_name, strlen(entry->d_name) };
+        struct kgsl_usage *usage;
+        unsigned long pid;
+
+        if (!memtrack_token_to_ulong(&token, &pid))
+            continue;
+        usage = kgsl_add_usage();
+        if (usage == NULL)
+            break;
+        if (kgsl_parse_mem((pid_t)pid, usage) != 0)
+            usage_count--;
+    }
+
+    closedir(dir);
+}
+
+static int kgsl_get_usage(pid_t pid, struct kgsl_usage *result)
+{
+    size_t i;
+    int ret = 0;
+
+    pthread_mutex_lock(&usage_lock);
+
+    if (!usage_valid ||
+        memtrack_now_ms() - usage_time > MEMTRACK_CACHE_TTL_MS) {
+        kgsl_refresh_usage();
+    }
+
+    for (i = 0; i < usage_count; i++) {
+        if (usage_cache[i].pid == pid)
+            break;
     }
 
+    if (i < usage_count) {
+        *result = usage_cache[i];
+    } else {
+        /* Started using the GPU after the walk, or not at all */
+        struct kgsl_usage *usage;
+        ret = kgsl_parse_mem(pid, result);
+        if (ret == 0 && (usage = kgsl_add_usage()) != NULL)
+            *usage = *result;
+    }
+
+    pthread_mutex_unlock(&usage_lock);
+    return ret;
+}
+
+static bool is_surfaceflinger(pid_t pid)
+{
+    FILE *fp;
+    char tmp[128];
+    char line[1024];
+    bool ret = false;
+
     snprintf(tmp, sizeof(tmp), "/proc/%d/cmdline", pid);
     fp = fopen(tmp, "r");
     if (fp != NULL) {
         if (fgets(line, sizeof(line), fp)) {
             if (strcmp(line, "/system/bin/surfaceflinger") == 0)
-                is_surfaceflinger = true;
+                ret = true;
         }
         fclose(fp);
     }
+    return ret;
+}
 
-    memcpy(records, record_templates,
-           sizeof(struct memtrack_record) * allocated_records);
+int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
+                             struct memtrack_record *records,
+                             size_t *num_records)
+{
+    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
+    struct kgsl_usage usage;
+    size_t accounted_size = 0;
+    size_t unaccounted_size = 0;
+    int ret;
 
-    sprintf(tmp, "/d/kgsl/proc/%d/mem", pid);
-    fp = fopen(tmp, "r");
-    if (fp == NULL) {
-        return -errno;
-    }
+    *num_records = ARRAY_SIZE(record_templates);
 
-    /* Go through each line of <pid>/mem file and for every entry of type "gpumem"
-     * check if the gpubuffer entry is usermapped or not. If the entry is usermapped
-     * count the entry as accounted else count the entry as unaccounted.
-     */
-    while (1) {
-        unsigned long size;
-        char line_type[7];
-        char flags[7];
-        char line_usage[19];
-        int ret;
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0) {
+        return 0;
+    }
 
-        if (fgets(line, sizeof(line), fp) == NULL) {
-            break;
-        }
+    memcpy(records, record_templates,
+           sizeof(struct memtrack_record) * allocated_records);
 
-        /* Format:
-         *  gpuaddr useraddr     size    id flags       type            usage sglen
-         * 545ba000 545ba000     4096     1 ----pY     gpumem      arraybuffer     1
-         */
-        ret = sscanf(line, "%*x %*lx %lu %*d %6s %6s %18s %*d\n",
-                     &size, flags, line_type, line_usage);
-        if (ret != 4) {
-            continue;
-        }
+    ret = kgsl_get_usage(pid, &usage);
+    if (ret != 0) {
+        return ret;
+    }
 
-        if (type == MEMTRACK_TYPE_GL && strcmp(line_type, "gpumem") == 0) {
-            if (flags[5] == 'Y')
-                accounted_size += size;
-            else
-                unaccounted_size += size;
-        } else if (type == MEMTRACK_TYPE_GRAPHICS && strcmp(line_type, "ion") == 0) {
-            if (!is_surfaceflinger || strcmp(line_usage, "egl_image") != 0) {
-                unaccounted_size += size;
-            }
-        }
+    if (type == MEMTRACK_TYPE_GL) {
+        accounted_size = usage.gl_accounted;
+        unaccounted_size = usage.gl_unaccounted;
+    } else if (type == MEMTRACK_TYPE_GRAPHICS) {
+        unaccounted_size = usage.ion;
+        /* Only look the process up when it would make a difference */
+        if (usage.ion_egl_image && is_surfaceflinger(pid))
+            unaccounted_size -= usage.ion_egl_image;
     }
 
     if (allocated_records > 0) {
@@ -122,7 +245,5 @@ int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
         records[1].size_in_bytes = unaccounted_size;
     }
 
-    fclose(fp);
-
     return 0;
 }
@@ -35,6 +35,10 @@ int msm_memtrack_get_memory(const struct memtrack_module *module,
         return kgsl_memtrack_get_memory(pid, type, records, num_records);
     }
 
+    if (type == MEMTRACK_TYPE_MULTIMEDIA || type == MEMTRACK_TYPE_CAMERA) {
+        return ion_memtrack_get_memory(pid, type, records, num_records);
+    }
+
     return -EINVAL;
 }
 
@@ -17,8 +17,83 @@
 #ifndef _MEMTRACK_EXYNOS5_H_
 #define _MEMTRACK_EXYNOS5_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Per process usage is collected for all processes in one go and reused
+ * for this long, dumpsys meminfo queries every process in turn.
+ */
+#define MEMTRACK_CACHE_TTL_MS 1000
+
 int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
                              struct memtrack_record *records,
                              size_t *num_records);
 
+int ion_memtrack_get_memory(pid_t pid, enum memtrack_type type,
+                            struct memtrack_record *records,
+                            size_t *num_records);
+
+struct memtrack_token {
+    const char *str;
+    size_t len;
+};
+
+static inline uint64_t memtrack_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Split a debugfs line into whitespace separated tokens, returns how many
+ * were found, at most max.
+ */
+static inline size_t memtrack_tokenize(const char *line,
+                                       struct memtrack_token *tokens,
+                                       size_t max)
+{
+    size_t count = 0;
+    const char *p = line;
+
+    while (count < max) {
+        while (*p == ' ' || *p == '\t' || *p == '\n')
+            p++;
+        if (*p == '\0')
+            break;
+        tokens[count].str = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n')
+            p++;
+        tokens[count].len = p - tokens[count].str;
+        count++;
+    }
+    return count;
+}
+
+static inline bool memtrack_token_equals(const struct memtrack_token *token,
+                                         const char *str)
+{
+    return strlen(str) == token->len &&
+           memcmp(token->str, str, token->len) == 0;
+}
+
+/* Decimal only, fails on anything else */
+static inline bool memtrack_token_to_ulong(const struct memtrack_token *token,
+                                           unsigned long *value)
+{
+    unsigned long v = 0;
+    size_t i;
+
+    if (token->len == 0)
+        return false;
+    for (i = 0; i < token->len; i++) {
+        if (token->str[i] < '0' || token->str[i] > '9')
+            return false;
+        v = v * 10 + (token->str[i] - '0');
+    }
+    *value = v;
+    return true;
+}
+
 #endif
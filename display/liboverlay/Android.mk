@@ -12,8 +12,10 @@ LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
 LOCAL_SRC_FILES := \
       overlay.cpp \
       overlayUtils.cpp \
+      mdpWrapper.cpp \
       overlayMdp.cpp \
       overlayRotator.cpp \
+      overlayRotMgr.cpp \
       overlayMdpRot.cpp \
       overlayMdssRot.cpp \
       pipes/overlayGenPipe.cpp
@@ -44,7 +44,18 @@
 
 namespace overlay{
 
+/* The ioctls below and overlay::open() are defined in mdpWrapper.cpp, the
+ * only place liboverlay reaches the MDP. The host simulator in
+ * libhwcomposer/sim replaces that file. */
 namespace mdp_wrapper{
+/* Overlay ioctl counts since start */
+struct IoctlCount {
+    uint32_t set;
+    uint32_t unset;
+    uint32_t play;
+};
+extern IoctlCount gIoctlCount;
+
 /* FBIOGET_FSCREENINFO */
 bool getFScreenInfo(int fd, fb_fix_screeninfo& finfo);
 
@@ -64,7 +75,7 @@ bool rotate(int fd, msm_rotator_data_info& rot);
 bool setOverlay(int fd, mdp_overlay& ov);
 
 /* MSM_ROTATOR_IOCTL_FINISH */
-bool endRotator(int fd, int sessionId);
+bool endRotator(int fd, uint32_t sessionId);
 
 /* MSMFB_OVERLAY_UNSET */
 bool unsetOverlay(int fd, int ovId);
@@ -78,6 +89,9 @@ bool play(int fd, msmfb_overlay_data& od);
 /* MSMFB_OVERLAY_3D */
 bool set3D(int fd, msmfb_overlay_3d& ov);
 
+/* MSMFB_MIXER_INFO */
+bool getMixerInfo(int fd, msmfb_mixer_info_req& req);
+
 /* the following are helper functions for dumping
  * msm_mdp and friends*/
 void dump(const char* const s, const msmfb_overlay_data& ov);
@@ -98,105 +112,6 @@ void dump(const char* const s, const fb_var_screeninfo& vinfo);
 
 //---------------Inlines -------------------------------------
 
-inline bool getFScreenInfo(int fd, fb_fix_screeninfo& finfo) {
-    if (ioctl(fd, FBIOGET_FSCREENINFO, &finfo) < 0) {
-        ALOGE("Failed to call ioctl FBIOGET_FSCREENINFO err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool getVScreenInfo(int fd, fb_var_screeninfo& vinfo) {
-    if (ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) < 0) {
-        ALOGE("Failed to call ioctl FBIOGET_VSCREENINFO err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool setVScreenInfo(int fd, fb_var_screeninfo& vinfo) {
-    if (ioctl(fd, FBIOPUT_VSCREENINFO, &vinfo) < 0) {
-        ALOGE("Failed to call ioctl FBIOPUT_VSCREENINFO err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool startRotator(int fd, msm_rotator_img_info& rot) {
-    if (ioctl(fd, MSM_ROTATOR_IOCTL_START, &rot) < 0){
-        ALOGE("Failed to call ioctl MSM_ROTATOR_IOCTL_START err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool rotate(int fd, msm_rotator_data_info& rot) {
-    if (ioctl(fd, MSM_ROTATOR_IOCTL_ROTATE, &rot) < 0) {
-        ALOGE("Failed to call ioctl MSM_ROTATOR_IOCTL_ROTATE err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool setOverlay(int fd, mdp_overlay& ov) {
-    if (ioctl(fd, MSMFB_OVERLAY_SET, &ov) < 0) {
-        ALOGE("Failed to call ioctl MSMFB_OVERLAY_SET err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool endRotator(int fd, uint32_t sessionId) {
-    if (ioctl(fd, MSM_ROTATOR_IOCTL_FINISH, &sessionId) < 0) {
-        ALOGE("Failed to call ioctl MSM_ROTATOR_IOCTL_FINISH err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool unsetOverlay(int fd, int ovId) {
-    if (ioctl(fd, MSMFB_OVERLAY_UNSET, &ovId) < 0) {
-        ALOGE("Failed to call ioctl MSMFB_OVERLAY_UNSET err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool getOverlay(int fd, mdp_overlay& ov) {
-    if (ioctl(fd, MSMFB_OVERLAY_GET, &ov) < 0) {
-        ALOGE("Failed to call ioctl MSMFB_OVERLAY_GET err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool play(int fd, msmfb_overlay_data& od) {
-    if (ioctl(fd, MSMFB_OVERLAY_PLAY, &od) < 0) {
-        ALOGE("Failed to call ioctl MSMFB_OVERLAY_PLAY err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
-inline bool set3D(int fd, msmfb_overlay_3d& ov) {
-    if (ioctl(fd, MSMFB_OVERLAY_3D, &ov) < 0) {
-        ALOGE("Failed to call ioctl MSMFB_OVERLAY_3D err=%s",
-                strerror(errno));
-        return false;
-    }
-    return true;
-}
-
 /* dump funcs */
 inline void dump(const char* const s, const msmfb_overlay_data& ov) {
     ALOGE("%s msmfb_overlay_data id=%d",
@@ -31,6 +31,7 @@
 #include "pipes/overlayGenPipe.h"
 #include "mdp_version.h"
 #include "qdMetaData.h"
+#include "mdpWrapper.h"
 
 #define PIPE_DEBUG 0
 
@@ -44,6 +45,8 @@ Overlay::Overlay() {
     }
 
     mDumpStr[0] = '\0';
+    mLastSet = mLastUnset = mLastPlay = 0;
+    mLastDumpTime = systemTime();
 }
 
 Overlay::~Overlay() {
@@ -81,26 +84,41 @@ void Overlay::configDone() {
     PipeBook::save();
 }
 
-eDest Overlay::nextPipe(eMdpPipeType type, int dpy) {
-    eDest dest = OV_INVALID;
-
+int Overlay::findPipe(eMdpPipeType type, int dpy, int key) {
+    int candidate = -1;
+    bool candidateHeld = false;
     for(int i = 0; i < PipeBook::NUM_PIPES; i++) {
         //Match requested pipe type
-        if(type == OV_MDP_PIPE_ANY || type == PipeBook::getPipeType((eDest)i)) {
-            //If the pipe is not allocated to any display or used by the
-            //requesting display already in previous round.
-            if((mPipeBook[i].mDisplay == PipeBook::DPY_UNUSED ||
-                    mPipeBook[i].mDisplay == dpy) &&
-                    PipeBook::isNotAllocated(i)) {
-                dest = (eDest)i;
-                PipeBook::setAllocation(i);
-                break;
-            }
+        if(type != OV_MDP_PIPE_ANY && type != PipeBook::getPipeType((eDest)i))
+            continue;
+        //The pipe must be not allocated to any display or used by the
+        //requesting display already in previous round.
+        if((mPipeBook[i].mDisplay != PipeBook::DPY_UNUSED &&
+                mPipeBook[i].mDisplay != dpy) || PipeBook::isAllocated(i))
+            continue;
+        //Same layer as last round, keeps its config
+        if(key != KEY_NONE && mPipeBook[i].mKey == key &&
+                mPipeBook[i].valid())
+            return i;
+        //Otherwise prefer pipes no other layer held last round
+        bool held = mPipeBook[i].valid() && mPipeBook[i].mKey != KEY_NONE;
+        if(candidate < 0 || (candidateHeld && !held)) {
+            candidate = i;
+            candidateHeld = held;
         }
     }
+    return candidate;
+}
+
+eDest Overlay::nextPipe(eMdpPipeType type, int dpy, int key) {
+    eDest dest = OV_INVALID;
+
+    int index = findPipe(type, dpy, key);
+    if(index >= 0) {
+        dest = (eDest)index;
+        PipeBook::setAllocation(index);
+        mPipeBook[index].mKey = key;
 
-    if(dest != OV_INVALID) {
-        int index = (int)dest;
         //If the pipe is not registered with any display OR if the pipe is
         //requested again by the same display using it, then go ahead.
         mPipeBook[index].mDisplay = dpy;
@@ -196,6 +214,9 @@ void Overlay::setSource(const utils::PipeArgs args,
 }
 
 void Overlay::setVisualParams(const MetaData_t& metadata, utils::eDest dest) {
+    // Most buffers carry no post processing, don't walk the pipe for them
+    if(!(metadata.operation & PP_PARAM_MASK))
+        return;
     int index = (int)dest;
     validate(index);
     mPipeBook[index].mPipe->setVisualParams(metadata);
@@ -231,21 +252,18 @@ int Overlay::initOverlay() {
     if (mdpVersion < qdutils::MDSS_V5) {
         msmfb_mixer_info_req  req;
         mdp_mixer_info *minfo = NULL;
-        char name[64];
-        int fd = -1;
+        OvFD fd;
         for(int i = 0; i < NUM_FB_DEVICES; i++) {
-            snprintf(name, 64, FB_DEVICE_TEMPLATE, i);
-            ALOGD("initoverlay:: opening the device:: %s", name);
-            fd = ::open(name, O_RDWR, 0);
-            if(fd < 0) {
+            ALOGD("initoverlay:: opening the device:: fb%d", i);
+            if(!overlay::open(fd, i, FB_DEVICE_TEMPLATE)) {
                 ALOGE("cannot open framebuffer(%d)", i);
                 return -1;
             }
             //Get the mixer configuration */
             req.mixer_num = i;
-            if (ioctl(fd, MSMFB_MIXER_INFO, &req) == -1) {
+            if (!mdp_wrapper::getMixerInfo(fd.getFD(), req)) {
                 ALOGE("ERROR: MSMFB_MIXER_INFO ioctl failed");
-                close(fd);
+                fd.close();
                 return -1;
             }
             minfo = req.info;
@@ -255,15 +273,14 @@ int Overlay::initOverlay() {
                 // clear any pipe connected to mixer including base pipe.
                 int index = minfo->pndx;
                 ALOGD("Unset overlay with index: %d at mixer %d", index, i);
-                if(ioctl(fd, MSMFB_OVERLAY_UNSET, &index) == -1) {
+                if(!mdp_wrapper::unsetOverlay(fd.getFD(), index)) {
                     ALOGE("ERROR: MSMFB_OVERLAY_UNSET failed");
-                    close(fd);
+                    fd.close();
                     return -1;
                 }
                 minfo++;
             }
-            close(fd);
-            fd = -1;
+            fd.close();
         }
     }
     return 0;
@@ -291,11 +308,30 @@ void Overlay::getDump(char *buf, size_t len) {
     char str_pipes[64] = {'\0'};
     snprintf(str_pipes, 64, "Pipes used=%d\n\n", totalPipes);
     strncat(buf, str_pipes, strlen(str_pipes));
+
+    //Ioctl rates since the previous dump
+    const mdp_wrapper::IoctlCount& cnt = mdp_wrapper::gIoctlCount;
+    nsecs_t now = systemTime();
+    float secs = (float)(now - mLastDumpTime) / 1000000000.0f;
+    if(secs <= 0.0f)
+        secs = 1.0f;
+    char str_ioctl[128] = {'\0'};
+    snprintf(str_ioctl, 128, "Ioctls set=%u (%.1f/s) unset=%u (%.1f/s) "
+             "play=%u (%.1f/s)\n\n",
+             cnt.set, (cnt.set - mLastSet) / secs,
+             cnt.unset, (cnt.unset - mLastUnset) / secs,
+             cnt.play, (cnt.play - mLastPlay) / secs);
+    strncat(buf, str_ioctl, strlen(str_ioctl));
+    mLastSet = cnt.set;
+    mLastUnset = cnt.unset;
+    mLastPlay = cnt.play;
+    mLastDumpTime = now;
 }
 
 void Overlay::PipeBook::init() {
     mPipe = NULL;
     mDisplay = DPY_UNUSED;
+    mKey = KEY_NONE;
 }
 
 void Overlay::PipeBook::destroy() {
@@ -304,6 +340,7 @@ void Overlay::PipeBook::destroy() {
         mPipe = NULL;
     }
     mDisplay = DPY_UNUSED;
+    mKey = KEY_NONE;
 }
 
 Overlay* Overlay::sInstance = 0;
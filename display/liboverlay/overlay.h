@@ -40,6 +40,12 @@ class GenericPipe;
 
 class Overlay : utils::NoCopy {
 public:
+    /* Keys for nextPipe(). A pipe handed out under a key is preferred for the
+     * same key and display in the next round, so that unchanged layers keep
+     * their pipe and MdpCtrl can skip the OVERLAY_SET. Layers use
+     * KEY_LAYER + their z-order. */
+    enum { KEY_NONE = 0, KEY_FB, KEY_BASE, KEY_LAYER };
+
     /* dtor close */
     ~Overlay();
 
@@ -60,7 +66,7 @@ public:
      * available for the display "dpy" then INV is returned. Note: If a pipe is
      * assigned to a certain display, then it cannot be assigned to another
      * display without being garbage-collected once */
-    utils::eDest nextPipe(utils::eMdpPipeType, int dpy);
+    utils::eDest nextPipe(utils::eMdpPipeType, int dpy, int key = KEY_NONE);
 
     void setSource(const utils::PipeArgs args, utils::eDest dest);
     void setCrop(const utils::Dim& d, utils::eDest dest);
@@ -91,6 +97,9 @@ private:
     /*Validate index range, abort if invalid */
     void validate(int index);
     void dump() const;
+    /* Returns a pipe of the type that can be allocated to dpy, preferring
+     * the one used for key last round, INV if none */
+    int findPipe(utils::eMdpPipeType type, int dpy, int key);
 
     /* Just like a Facebook for pipes, but much less profile info */
     struct PipeBook {
@@ -105,6 +114,8 @@ private:
         GenericPipe *mPipe;
         /* Display using this pipe. Refer to enums above */
         int mDisplay;
+        /* Key this pipe was last allocated for */
+        int mKey;
 
         /* operations on bitmap */
         static bool pipeUsageUnchanged();
@@ -145,6 +156,10 @@ private:
     /* Dump string */
     char mDumpStr[256];
 
+    /* Ioctl counts and time at the previous getDump, for rates */
+    uint32_t mLastSet, mLastUnset, mLastPlay;
+    nsecs_t mLastDumpTime;
+
     /* Singleton Instance*/
     static Overlay *sInstance;
     static int sExtFbIndex;
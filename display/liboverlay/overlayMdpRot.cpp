@@ -197,13 +197,22 @@ bool MdpRot::close() {
 }
 
 bool MdpRot::remap(uint32_t numbufs) {
-    // if current size changed, remap
+    // if current buffers are too small or too large, remap
     uint32_t opBufSize = calcOutputBufSize();
-    if(opBufSize == mMem.curr().size()) {
+    if(mMem.curr().fits(opBufSize)) {
         ALOGE_IF(DEBUG_OVERLAY, "%s: same size %d", __FUNCTION__, opBufSize);
         return true;
     }
 
+    // Going back to the previous size, e.g. rotating back, reuses the
+    // previous buffers as they are.
+    if(mMem.prev().fits(opBufSize)) {
+        ALOGE_IF(DEBUG_OVERLAY, "%s: back to prev size %d", __FUNCTION__,
+                mMem.prev().size());
+        ++mMem;
+        return true;
+    }
+
     ALOGE_IF(DEBUG_OVERLAY, "%s: size changed - remapping", __FUNCTION__);
 
     // ++mMem will make curr to be prev, and prev will be curr
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ * Copyright (c) 2010-2012, The Linux Foundation. All rights reserved.
+ * Not a Contribution, Apache license notifications and license are retained
+ * for attribution purposes only.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include "overlayRotator.h"
+#include "overlayUtils.h"
+
+namespace overlay {
+
+//============RotMgr=========================
+
+RotMgr::RotMgr() {
+    for(int i = 0; i < MAX_SESS; i++) {
+        mSess[i].rot = 0;
+        mSess[i].inUse = false;
+        mSess[i].lastUse = 0;
+    }
+    mUseCount = 0;
+    mRotDevFd = -1;
+}
+
+RotMgr::~RotMgr() {
+    clear();
+}
+
+void RotMgr::configBegin() {
+    //Reset the number of objects used
+    mUseCount = 0;
+    for(int i = 0; i < MAX_SESS; i++) {
+        mSess[i].inUse = false;
+    }
+}
+
+void RotMgr::configDone() {
+    //Videos come and go. Drop sessions idle for too long, then keep only
+    //the most recently used of the rest.
+    nsecs_t now = systemTime();
+    int idle = 0;
+    for(int i = 0; i < MAX_SESS; i++) {
+        if(mSess[i].rot && !mSess[i].inUse) {
+            if(now - mSess[i].lastUse > ms2ns(ROT_IDLE_TIMEOUT_MS))
+                destroy(i);
+            else
+                idle++;
+        }
+    }
+    while(idle > MAX_IDLE_ROT_SESS) {
+        int lru = -1;
+        for(int i = 0; i < MAX_SESS; i++) {
+            if(mSess[i].rot && !mSess[i].inUse && (lru < 0 ||
+                    mSess[i].lastUse < mSess[lru].lastUse))
+                lru = i;
+        }
+        destroy(lru);
+        idle--;
+    }
+}
+
+Rotator* RotMgr::getNext(const utils::Whf& whf,
+        const utils::eTransform& rot) {
+    if(mUseCount >= MAX_ROT_SESS) {
+        ALOGE("%s, MAX rotator sessions reached", __func__);
+        return NULL;
+    }
+
+    //Pick the idle session set up for this source if any, else a new one
+    //while there is room, else recycle the least recently used.
+    int match = -1, empty = -1, lru = -1;
+    for(int i = 0; i < MAX_SESS; i++) {
+        Session& sess = mSess[i];
+        if(sess.rot == NULL) {
+            if(empty < 0)
+                empty = i;
+        } else if(!sess.inUse) {
+            if(sess.whf == whf && sess.transform == rot) {
+                match = i;
+                break;
+            }
+            if(lru < 0 || sess.lastUse < mSess[lru].lastUse)
+                lru = i;
+        }
+    }
+
+    int index = (match >= 0) ? match : ((empty >= 0) ? empty : lru);
+    if(index < 0) {
+        ALOGE("%s, no rotator session available", __func__);
+        return NULL;
+    }
+    Session& sess = mSess[index];
+    if(sess.rot == NULL) {
+        sess.rot = overlay::Rotator::getRotator();
+        if(sess.rot == NULL)
+            return NULL;
+    }
+    sess.whf = whf;
+    sess.transform = rot;
+    sess.inUse = true;
+    sess.lastUse = systemTime();
+    mUseCount++;
+    return sess.rot;
+}
+
+void RotMgr::destroy(int index) {
+    delete mSess[index].rot;
+    mSess[index].rot = 0;
+    mSess[index].inUse = false;
+}
+
+void RotMgr::clear() {
+    //Brute force obj destruction, helpful in suspend.
+    for(int i = 0; i < MAX_SESS; i++) {
+        if(mSess[i].rot) {
+            destroy(i);
+        }
+    }
+    mUseCount = 0;
+    ::close(mRotDevFd);
+    mRotDevFd = -1;
+}
+
+void RotMgr::getDump(char *buf, size_t len) {
+    int idle = 0;
+    for(int i = 0; i < MAX_SESS; i++) {
+        if(mSess[i].rot && mSess[i].inUse) {
+            mSess[i].rot->getDump(buf, len);
+        } else if(mSess[i].rot) {
+            idle++;
+        }
+    }
+    char str[64] = {'\0'};
+    snprintf(str, 64, "\nRotMgr: %d in use, %d idle\n================\n",
+            mUseCount, idle);
+    strncat(buf, str, strlen(str));
+}
+
+}
@@ -31,6 +31,7 @@
 #define OVERlAY_ROTATOR_H
 
 #include <stdlib.h>
+#include <utils/Timers.h>
 
 #include "mdpWrapper.h"
 #include "overlayUtils.h"
@@ -55,6 +56,9 @@ struct RotMem {
         bool valid() { return m.valid(); }
         bool close();
         uint32_t size() const { return m.bufSz(); }
+        /* true if valid and large enough for, but not wasteful of, sz */
+        bool fits(uint32_t sz) { return valid() && size() >= sz &&
+                size() <= 2 * sz; }
         void setReleaseFd(const int& fence);
         // Max rotator buffers
         enum { ROT_NUM_BUFS = 3 };
@@ -227,11 +231,19 @@ public:
     //Maximum sessions based on VG pipes, since rotator is used only for videos.
     //Even though we can have 4 mixer stages, that much may be unnecessary.
     enum { MAX_ROT_SESS = 3 };
+    //Sessions not used in a frame stay configured, with their buffers, for
+    //a while. A video going back to overlay after GPU composition or
+    //rotating back picks its old session up again.
+    enum { MAX_IDLE_ROT_SESS = 2 };
+    enum { ROT_IDLE_TIMEOUT_MS = 3000 };
     RotMgr();
     ~RotMgr();
     void configBegin();
     void configDone();
-    overlay::Rotator *getNext();
+    /* Returns a rotator, preferably the one last used for this source and
+     * transform */
+    overlay::Rotator *getNext(const utils::Whf& whf,
+            const utils::eTransform& rot);
     void clear(); //Removes all instances
     /* Returns rot dump.
      * Expects a NULL terminated buffer of big enough size.
@@ -239,7 +251,17 @@ public:
     void getDump(char *buf, size_t len);
     int getRotDevFd(); //Called on A-fam only
 private:
-    overlay::Rotator *mRot[MAX_ROT_SESS];
+    struct Session {
+        overlay::Rotator *rot;
+        /* Source and transform the session was last used for */
+        utils::Whf whf;
+        utils::eTransform transform;
+        bool inUse;
+        nsecs_t lastUse;
+    };
+    enum { MAX_SESS = MAX_ROT_SESS + MAX_IDLE_ROT_SESS };
+    void destroy(int index);
+    Session mSess[MAX_SESS];
     int mUseCount;
     int mRotDevFd; //A-fam
 };
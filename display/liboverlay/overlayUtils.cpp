@@ -191,12 +191,20 @@ int getDownscaleFactor(const int& src_w, const int& src_h,
     // This saves bandwidth and avoids causing the driver to make too many panel
     // -mode switches between BLT (writeback) and non-BLT (Direct) modes.
     // Use-case: Video playback [with downscaling and rotation].
-    if (dst_w && dst_h)
+    if (src_w > 0 && src_h > 0 && dst_w > 0 && dst_h > 0)
     {
-        float fDscale =  sqrtf((float)(src_w * src_h) / (float)(dst_w * dst_h)) +
-                         fDscaleTolerance;
+        // Plan the rotator and MDP scaling jointly, per axis. The rotator
+        // shrinks both axes equally, so the axis needing the least downscale
+        // bounds what it can do without making the MDP upscale past the
+        // tolerance below. The axis needing the most downscale decides
+        // whether the MDP can handle the remainder on its own.
+        float fScaleX = (float)src_w / (float)dst_w;
+        float fScaleY = (float)src_h / (float)dst_h;
+        float fMinScale = fScaleX < fScaleY ? fScaleX : fScaleY;
+        float fMaxScale = fScaleX < fScaleY ? fScaleY : fScaleX;
+        float fDscale = fMinScale + fDscaleTolerance;
 
-        // On our MTP 1080p playback case downscale after sqrt is coming to 1.87
+        // On our MTP 1080p playback case downscale is coming to 1.87
         // we were rounding to 1. So entirely MDP has to do the downscaling.
         // BW requirement and clock requirement is high across MDP4 targets.
         // It is unable to downscale 1080p video to panel resolution on 8960.
@@ -216,6 +224,14 @@ int getDownscaleFactor(const int& src_w, const int& src_h,
             // Down-scale to <= 12.5% of orig.
             dscale_factor = utils::ROT_DS_EIGHTH;
         }
+
+        // Whatever the rotator leaves must be within the MDP minification
+        // limit, else the pipe cannot be configured at all.
+        while(dscale_factor < utils::ROT_DS_EIGHTH &&
+                fMaxScale / (float)(1 << dscale_factor) >
+                (float)utils::HW_OV_MINIFICATION_LIMIT) {
+            dscale_factor++;
+        }
     }
     return dscale_factor;
 }
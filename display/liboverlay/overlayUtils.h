@@ -789,13 +789,6 @@ private:
 
 //-------------------Inlines--------------------------
 
-inline bool open(OvFD& fd, uint32_t fbnum, const char* const dev, int flags)
-{
-    char dev_name[64] = {0};
-    snprintf(dev_name, sizeof(dev_name), dev, fbnum);
-    return fd.open(dev_name, flags);
-}
-
 inline OvFD::OvFD() : mFD (INVAL) {
     mPath[0] = 0;
 }
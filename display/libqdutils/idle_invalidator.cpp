@@ -37,7 +37,7 @@ InvalidatorHandler IdleInvalidator::mHandler = NULL;
 android::sp<IdleInvalidator> IdleInvalidator::sInstance(0);
 
 IdleInvalidator::IdleInvalidator(): Thread(false), mHwcContext(0),
-    mSleepAgain(false), mSleepTime(0) {
+    mSleepTime(0), mDeadline(0), mFireCount(0) {
         ALOGD_IF(II_DEBUG, "%s", __func__);
     }
 
@@ -54,15 +54,22 @@ int IdleInvalidator::init(InvalidatorHandler reg_handler, void* user_data,
 
 bool IdleInvalidator::threadLoop() {
     ALOGD_IF(II_DEBUG, "%s", __func__);
-    usleep(mSleepTime * 500);
-    if(mSleepAgain) {
-        //We need to sleep again!
-        mSleepAgain = false;
-        return true;
+    {
+        android::Mutex::Autolock lock(mLock);
+        //Sleep until armed, then until the deadline stops moving
+        while(mDeadline == 0)
+            mCond.wait(mLock);
+        nsecs_t now = systemTime();
+        while(now < mDeadline) {
+            mCond.waitRelative(mLock, mDeadline - now);
+            now = systemTime();
+        }
+        mDeadline = 0;
+        mFireCount++;
     }
 
     mHandler((void*)mHwcContext);
-    return false;
+    return true;
 }
 
 int IdleInvalidator::readyToRun() {
@@ -75,8 +82,15 @@ void IdleInvalidator::onFirstRef() {
 }
 
 void IdleInvalidator::markForSleep() {
-    mSleepAgain = true;
-    //Triggers the threadLoop to run, if not already running.
+    {
+        android::Mutex::Autolock lock(mLock);
+        bool wasArmed = (mDeadline != 0);
+        mDeadline = systemTime() + ms2ns(mSleepTime);
+        //A running wait just picks up the later deadline when it wakes
+        if(!wasArmed)
+            mCond.signal();
+    }
+    //Starts the threadLoop, if not already running.
     run(threadName, android::PRIORITY_AUDIO);
 }
 
@@ -32,13 +32,19 @@
 
 #include <cutils/log.h>
 #include <utils/threads.h>
+#include <utils/Timers.h>
 
 typedef void (*InvalidatorHandler)(void*);
 
 class IdleInvalidator : public android::Thread {
     void *mHwcContext;
-    bool mSleepAgain;
     unsigned int mSleepTime;
+    /* time at which the handler fires, 0 when disarmed */
+    nsecs_t mDeadline;
+    /* times the handler fired, shown in the MDPComp dump */
+    unsigned int mFireCount;
+    android::Mutex mLock;
+    android::Condition mCond;
     static InvalidatorHandler mHandler;
     static android::sp<IdleInvalidator> sInstance;
 
@@ -47,7 +53,10 @@ class IdleInvalidator : public android::Thread {
     /* init timer obj */
     int init(InvalidatorHandler reg_handler, void* user_data, unsigned int
              idleSleepTime);
+    /* (re)arm the timer for a full idle window from now */
     void markForSleep();
+    unsigned int getIdleTime() const { return mSleepTime; }
+    unsigned int getFireCount() const { return mFireCount; }
     /*Overrides*/
     virtual bool        threadLoop();
     virtual int         readyToRun();
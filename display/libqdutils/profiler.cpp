@@ -28,8 +28,64 @@
  */
 
 #define LOG_NDDEBUG 0
+#include <string.h>
+#include <cutils/atomic.h>
 #include "profiler.h"
 
+namespace qdutils {
+
+const int32_t CompStats::sBucketUs[CompStats::NUM_BUCKETS - 1] = {
+    1000, 2000, 4000, 8000, 16667, 33333, 50000 };
+CompStats::Stat CompStats::sStats[STAT_MAX];
+
+static const char *sStatNames[STAT_MAX] = {
+    "prepare", "set", "commit", "vsync2post" };
+
+void CompStats::record(eCompStat stat, nsecs_t duration) {
+    if(stat < 0 || stat >= STAT_MAX || duration < 0)
+        return;
+    Stat& s = sStats[stat];
+    int32_t us = (int32_t) ns2us(duration);
+    int bucket = 0;
+    while(bucket < NUM_BUCKETS - 1 && us >= sBucketUs[bucket])
+        bucket++;
+
+    android_atomic_inc(&s.count);
+    android_atomic_inc(&s.buckets[bucket]);
+    // No 64 bit android_atomic op, the gcc builtin covers it on all targets
+    __sync_fetch_and_add(&s.totalUs, (int64_t)us);
+    int32_t oldMax = s.maxUs;
+    while(us > oldMax) {
+        if(android_atomic_cmpxchg(oldMax, us, &s.maxUs) == 0)
+            break;
+        oldMax = s.maxUs;
+    }
+}
+
+void CompStats::dump(android::String8& buf) {
+    buf.appendFormat("  CompStats:      count  avg(us)  max(us) |"
+            "   <1ms   <2ms   <4ms   <8ms  <16ms  <33ms  <50ms  >50ms\n");
+    for(int i = 0; i < STAT_MAX; i++) {
+        const Stat& s = sStats[i];
+        int32_t count = s.count;
+        if(!count)
+            continue;
+        buf.appendFormat("  %-11s %9d %8lld %8d |", sStatNames[i], count,
+                (long long)(s.totalUs / count), s.maxUs);
+        for(int b = 0; b < NUM_BUCKETS; b++)
+            buf.appendFormat(" %6d", s.buckets[b]);
+        buf.appendFormat("\n");
+    }
+}
+
+void CompStats::reset() {
+    // Racing records may land on either side of the reset, that is fine
+    // for statistics.
+    memset((void *)sStats, 0, sizeof(sStats));
+}
+
+};//namespace qdutils
+
 #ifdef DEBUG_CALC_FPS
 
 namespace android {
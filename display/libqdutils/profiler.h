@@ -34,6 +34,42 @@
 #include <utils/Singleton.h>
 #include <cutils/properties.h>
 #include <cutils/log.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace qdutils {
+/* Composition stages timed by CompStats */
+enum eCompStat {
+    STAT_PREPARE = 0,
+    STAT_SET,
+    STAT_COMMIT,
+    STAT_VSYNC_TO_POST,
+    STAT_MAX,
+};
+
+/* Always-on composition statistics: per stage count, average, max and a
+ * frame time histogram. Recording only does atomic adds, so it is cheap
+ * enough for production builds and safe from any thread. Read out through
+ * hwc dumpsys and "dumpsys display.qservice".
+ */
+class CompStats {
+public:
+    static void record(eCompStat stat, nsecs_t duration);
+    static void dump(android::String8& buf);
+    static void reset();
+private:
+    // Histogram bucket upper bounds in us, the last bucket is open ended
+    static const int NUM_BUCKETS = 8;
+    static const int32_t sBucketUs[NUM_BUCKETS - 1];
+    struct Stat {
+        volatile int32_t count;
+        volatile int32_t maxUs;
+        volatile int64_t totalUs;
+        volatile int32_t buckets[NUM_BUCKETS];
+    };
+    static Stat sStats[STAT_MAX];
+};
+};//namespace qdutils
 
 #ifndef DEBUG_CALC_FPS
 #define CALC_FPS() ((void)0)
@@ -33,29 +33,50 @@
 #include <gralloc_priv.h>
 #include "qdMetaData.h"
 
-int setMetaData(private_handle_t *handle, DispParamType paramType,
-                                                    void *param) {
+/* Returns the metadata of a handle, mapping it only if this process does not
+ * have it mapped already. unmapMetaData() undoes the mapping if one was made.
+ */
+static MetaData_t *mapMetaData(private_handle_t *handle, bool& mapped) {
+    mapped = false;
     if (!handle) {
         ALOGE("%s: Private handle is null!", __func__);
-        return -1;
+        return NULL;
     }
+    if (handle->base_metadata)
+        return reinterpret_cast <MetaData_t *>(handle->base_metadata);
     if (handle->fd_metadata == -1) {
         ALOGE("%s: Bad fd for extra data!", __func__);
-        return -1;
-    }
-    if (!param) {
-        ALOGE("%s: input param is null!", __func__);
-        return -1;
+        return NULL;
     }
     unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
     void *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
         handle->fd_metadata, 0);
-    if (!base) {
+    if (base == MAP_FAILED || !base) {
         ALOGE("%s: mmap() failed: Base addr is NULL!", __func__);
+        return NULL;
+    }
+    mapped = true;
+    return reinterpret_cast <MetaData_t *>(base);
+}
+
+static void unmapMetaData(MetaData_t *data, bool mapped) {
+    unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
+    if(mapped && munmap(data, size))
+        ALOGE("%s: failed to unmap ptr 0x%x, err %d", __func__, (int)data,
+                                                                        errno);
+}
+
+int setMetaData(private_handle_t *handle, DispParamType paramType,
+                                                    void *param) {
+    if (!param) {
+        ALOGE("%s: input param is null!", __func__);
         return -1;
     }
-    MetaData_t *data = reinterpret_cast <MetaData_t *>(base);
-    data->operation |= paramType;
+    bool mapped = false;
+    MetaData_t *data = mapMetaData(handle, mapped);
+    if (!data)
+        return -1;
+    int ret = 0;
     switch (paramType) {
         case PP_PARAM_HSIC:
             memcpy((void *)&data->hsicData, param, sizeof(HSICData_t));
@@ -78,12 +99,16 @@ int setMetaData(private_handle_t *handle, DispParamType paramType,
         case UPDATE_BUFFER_GEOMETRY:
             memcpy((void *)&data->bufferDim, param, sizeof(BufferDim_t));
             break;
+        case UPDATE_REFRESH_RATE:
+            data->refreshrate = *((uint32_t *)param);
+            break;
         default:
             ALOGE("Unknown paramType %d", paramType);
+            ret = -1;
             break;
     }
-    if(munmap(base, size))
-        ALOGE("%s: failed to unmap ptr 0x%x, err %d", __func__, (int)base,
-                                                                        errno);
-    return 0;
+    if (!ret)
+        data->operation |= paramType;
+    unmapMetaData(data, mapped);
+    return ret;
 }
@@ -66,6 +66,7 @@ struct MetaData_t {
     int32_t video_interface;
     IGCData_t igcData;
     Sharp2Data_t Sharp2Data;
+    uint32_t refreshrate;
 };
 
 typedef enum {
@@ -76,8 +77,13 @@ typedef enum {
     PP_PARAM_IGC        = 0x0010,
     PP_PARAM_SHARP2     = 0x0020,
     UPDATE_BUFFER_GEOMETRY = 0x0080,
+    UPDATE_REFRESH_RATE    = 0x0100,
 } DispParamType;
 
+/* Parameters the MDP post processing block consumes */
+#define PP_PARAM_MASK (PP_PARAM_HSIC | PP_PARAM_SHARPNESS | PP_PARAM_VID_INTFC \
+                       | PP_PARAM_IGC | PP_PARAM_SHARP2)
+
 int setMetaData(private_handle_t *handle, DispParamType paramType, void *param);
 
 #endif /* _QDMETADATA_H */
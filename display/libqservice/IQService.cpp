@@ -64,6 +64,14 @@ public:
         remote()->transact(CONNECT, data, &reply);
     }
 
+    virtual void subscribe(const sp<IQClient>& client, uint32_t events) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IQService::getInterfaceDescriptor());
+        data.writeStrongBinder(IInterface::asBinder(client));
+        data.writeInt32(events);
+        remote()->transact(SUBSCRIBE, data, &reply);
+    }
+
     virtual status_t screenRefresh() {
         Parcel data, reply;
         data.writeInterfaceToken(IQService::getInterfaceDescriptor());
@@ -134,6 +142,21 @@ status_t BnQService::onTransact(
             connect(client);
             return NO_ERROR;
         } break;
+        case SUBSCRIBE: {
+            CHECK_INTERFACE(IQService, data, reply);
+            if(callerUid != AID_GRAPHICS && callerUid != AID_SYSTEM &&
+                    callerUid != AID_ROOT) {
+                ALOGE("display.qservice SUBSCRIBE access denied: \
+                      pid=%d uid=%d process=%s",
+                      callerPid, callerUid, callingProcName);
+                return PERMISSION_DENIED;
+            }
+            sp<IQClient> client =
+                interface_cast<IQClient>(data.readStrongBinder());
+            uint32_t events = data.readInt32();
+            subscribe(client, events);
+            return NO_ERROR;
+        } break;
         case SCREEN_REFRESH: {
             CHECK_INTERFACE(IQService, data, reply);
             if(callerUid != AID_SYSTEM) {
@@ -41,14 +41,30 @@ public:
         UNSECURING, // Hardware unsecuring start/end notification
         CONNECT,
         SCREEN_REFRESH,
+        SUBSCRIBE, // Connect a client for a set of events
     };
     enum {
         END = 0,
         START,
     };
+    // Events a client can subscribe to
+    enum {
+        EVENT_SECURING       = 0x1,
+        EVENT_UNSECURING     = 0x2,
+        EVENT_SCREEN_REFRESH = 0x4,
+        EVENT_ALL            = 0x7,
+    };
     virtual void securing(uint32_t startEnd) = 0;
     virtual void unsecuring(uint32_t startEnd) = 0;
+    // Subscribes the client to all events, replacing the client of an
+    // earlier connect
     virtual void connect(const android::sp<qClient::IQClient>& client) = 0;
+    // Events 0 drops the client
+    virtual void subscribe(const android::sp<qClient::IQClient>& client,
+                           uint32_t events) = 0;
+    // A request coalesced with one sent less than a vsync ago returns
+    // NO_ERROR right away, the callback result is only returned when the
+    // refresh goes out directly
     virtual android::status_t screenRefresh() = 0;
 };
 
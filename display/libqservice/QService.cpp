@@ -27,7 +27,11 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <unistd.h>
+#include <binder/IPCThreadState.h>
+#include <binder/PermissionCache.h>
 #include <QService.h>
+#include <profiler.h>
 
 #define QSERVICE_DEBUG 0
 
@@ -35,11 +39,15 @@ using namespace android;
 
 namespace qService {
 
+// Refresh requests closer together than a vsync at 60Hz are coalesced
+#define REFRESH_COALESCE_NS ms2ns(16)
+
 QService* QService::sQService = NULL;
 // ----------------------------------------------------------------------------
-QService::QService()
+QService::QService() : mLastRefresh(0), mPendingRefreshes(0)
 {
     ALOGD_IF(QSERVICE_DEBUG, "QService Constructor invoked");
+    mRefreshThread = new RefreshThread(this);
 }
 
 QService::~QService()
@@ -48,25 +56,144 @@ QService::~QService()
 }
 
 void QService::securing(uint32_t startEnd) {
-    if(mClient.get()) {
-        mClient->notifyCallback(SECURING, startEnd);
-    }
+    notify(EVENT_SECURING, SECURING, startEnd);
 }
 
 void QService::unsecuring(uint32_t startEnd) {
-    if(mClient.get()) {
-        mClient->notifyCallback(UNSECURING, startEnd);
-    }
+    notify(EVENT_UNSECURING, UNSECURING, startEnd);
 }
 
+// The hwc client. A reopened hwc connects again, the client of the closed
+// one must not stay subscribed as it points at a freed context.
 void QService::connect(const sp<qClient::IQClient>& client) {
-    mClient = client;
+    sp<qClient::IQClient> old;
+    {
+        Mutex::Autolock _l(mLock);
+        old = mClient;
+        mClient = client;
+    }
+    if(old.get() && old != client)
+        subscribe(old, 0);
+    subscribe(client, EVENT_ALL);
+}
+
+void QService::subscribe(const sp<qClient::IQClient>& client,
+                         uint32_t events) {
+    if(!client.get())
+        return;
+    sp<IBinder> binder = IInterface::asBinder(client);
+    Mutex::Autolock _l(mLock);
+    for(size_t i = 0; i < mSubscribers.size(); i++) {
+        if(IInterface::asBinder(mSubscribers[i].client) == binder) {
+            if(events) {
+                mSubscribers.editItemAt(i).events = events;
+            } else {
+                binder->unlinkToDeath(this);
+                mSubscribers.removeAt(i);
+            }
+            return;
+        }
+    }
+    if(events) {
+        Subscriber subscriber;
+        subscriber.client = client;
+        subscriber.events = events;
+        mSubscribers.add(subscriber);
+        //Fails for clients in this process, they do not die on their own
+        binder->linkToDeath(this);
+    }
+    ALOGD_IF(QSERVICE_DEBUG, "%s: %d clients", __FUNCTION__,
+             (int)mSubscribers.size());
+}
+
+void QService::binderDied(const wp<IBinder>& who) {
+    Mutex::Autolock _l(mLock);
+    for(size_t i = 0; i < mSubscribers.size(); i++) {
+        if(IInterface::asBinder(mSubscribers[i].client).get() ==
+                who.unsafe_get()) {
+            mSubscribers.removeAt(i);
+            break;
+        }
+    }
 }
 
 android::status_t QService::screenRefresh() {
+    {
+        Mutex::Autolock _l(mLock);
+        nsecs_t now = systemTime();
+        if(mPendingRefreshes || now - mLastRefresh < REFRESH_COALESCE_NS) {
+            // A refresh went out less than a vsync ago, the next frame
+            // would not pick up this one any earlier.
+            if(!mPendingRefreshes++)
+                mRefreshCond.signal();
+            //Starts the threadLoop, if not already running.
+            mRefreshThread->run("QServiceRefresh",
+                                android::PRIORITY_URGENT_DISPLAY);
+            return NO_ERROR;
+        }
+        mLastRefresh = now;
+    }
+    return notify(EVENT_SCREEN_REFRESH, SCREEN_REFRESH, 1);
+}
+
+bool QService::RefreshThread::threadLoop() {
+    uint32_t count = 0;
+    {
+        Mutex::Autolock _l(mService->mLock);
+        while(!mService->mPendingRefreshes)
+            mService->mRefreshCond.wait(mService->mLock);
+        nsecs_t due = mService->mLastRefresh + REFRESH_COALESCE_NS;
+        nsecs_t now = systemTime();
+        while(now < due) {
+            mService->mRefreshCond.waitRelative(mService->mLock, due - now);
+            now = systemTime();
+        }
+        count = mService->mPendingRefreshes;
+        mService->mPendingRefreshes = 0;
+        mService->mLastRefresh = now;
+    }
+    //The value carries the number of requests folded into this one
+    mService->notify(EVENT_SCREEN_REFRESH, SCREEN_REFRESH, count);
+    return true;
+}
+
+// "dumpsys display.qservice [reset]" prints the composition statistics
+status_t QService::dump(int fd, const Vector<String16>& args) {
+    String8 result;
+    if(!PermissionCache::checkCallingPermission(
+            String16("android.permission.DUMP"))) {
+        IPCThreadState* ipc = IPCThreadState::self();
+        result.appendFormat("Permission Denial: can't dump display.qservice "
+                "from pid=%d, uid=%d\n", ipc->getCallingPid(),
+                ipc->getCallingUid());
+    } else if(args.size() && args[0] == String16("reset")) {
+        qdutils::CompStats::reset();
+        result.appendFormat("  CompStats reset\n");
+    } else {
+        qdutils::CompStats::dump(result);
+        Mutex::Autolock _l(mLock);
+        result.appendFormat("  QService: %d clients, %u refreshes pending\n",
+                (int)mSubscribers.size(), mPendingRefreshes);
+    }
+    write(fd, result.string(), result.size());
+    return NO_ERROR;
+}
+
+// Called without mLock, a client may call back into the service
+android::status_t QService::notify(uint32_t event, uint32_t msg,
+                                   uint32_t value) {
+    Vector<Subscriber> subscribers;
+    {
+        Mutex::Autolock _l(mLock);
+        subscribers = mSubscribers;
+    }
     status_t result = NO_ERROR;
-    if(mClient.get()) {
-        result = mClient->notifyCallback(SCREEN_REFRESH, 0);
+    for(size_t i = 0; i < subscribers.size(); i++) {
+        if(subscribers[i].events & event) {
+            status_t ret = subscribers[i].client->notifyCallback(msg, value);
+            if(ret != NO_ERROR)
+                result = ret;
+        }
     }
     return result;
 }
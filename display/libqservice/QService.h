@@ -34,6 +34,9 @@
 #include <sys/types.h>
 #include <cutils/log.h>
 #include <binder/IServiceManager.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
 #include <IQService.h>
 #include <IQClient.h>
 
@@ -42,17 +45,50 @@ struct hwc_context_t;
 namespace qService {
 // ----------------------------------------------------------------------------
 
-class QService : public BnQService {
+class QService : public BnQService,
+                 public android::IBinder::DeathRecipient {
 public:
     virtual ~QService();
     virtual void securing(uint32_t startEnd);
     virtual void unsecuring(uint32_t startEnd);
     virtual void connect(const android::sp<qClient::IQClient>& client);
+    virtual void subscribe(const android::sp<qClient::IQClient>& client,
+                           uint32_t events);
     virtual android::status_t screenRefresh();
+    virtual void binderDied(const android::wp<android::IBinder>& who);
+    virtual android::status_t dump(int fd,
+            const android::Vector<android::String16>& args);
     static void init();
 private:
     QService();
+
+    struct Subscriber {
+        android::sp<qClient::IQClient> client;
+        uint32_t events;
+    };
+
+    // Delivers refresh requests that came in within a vsync of the last
+    // one as a single callback once that vsync is over
+    class RefreshThread : public android::Thread {
+    public:
+        RefreshThread(QService *service) : Thread(false),
+                mService(service) {}
+        virtual bool threadLoop();
+    private:
+        QService *mService;
+    };
+
+    android::status_t notify(uint32_t event, uint32_t msg, uint32_t value);
+
+    mutable android::Mutex mLock;
+    android::Condition mRefreshCond;
+    android::Vector<Subscriber> mSubscribers;
+    // Client of the last connect()
     android::sp<qClient::IQClient> mClient;
+    // Time of the last refresh callback and requests folded since
+    nsecs_t mLastRefresh;
+    uint32_t mPendingRefreshes;
+    android::sp<RefreshThread> mRefreshThread;
     static QService *sQService;
 };
 }; // namespace qService
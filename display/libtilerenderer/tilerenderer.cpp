@@ -15,18 +15,31 @@
  * limitations under the License.
  */
 
+#include <math.h>
+#include <stdlib.h>
+#include <cutils/properties.h>
 #include <GLES2/gl2.h>
 #include <EGL/egl.h>
 #include <gl2ext.h>
 #include <OpenGLRenderer.h>
+#include <Rect.h>
 #include "tilerenderer.h"
 
+//Default for debug.tilerenderer.min_area, about one GMEM bin
+#define MIN_TILE_AREA (64 * 64)
+
 namespace android {
 ANDROID_SINGLETON_STATIC_INSTANCE(uirenderer::TileRenderer) ;
 namespace uirenderer {
 
 TileRenderer::TileRenderer() {
+    char property[PROPERTY_VALUE_MAX];
     mIsTiled = false;
+    mTilesStarted = mTilesPreserved = mTilesSkipped = 0;
+    property_get("debug.tilerenderer.min_area", property, "0");
+    mMinTileArea = atoi(property);
+    if (mMinTileArea <= 0)
+        mMinTileArea = MIN_TILE_AREA;
 }
 
 TileRenderer::~TileRenderer() {
@@ -35,9 +48,46 @@ TileRenderer::~TileRenderer() {
 void TileRenderer::startTileRendering(OpenGLRenderer* renderer,
                                       int left, int top,
                                       int right, int bottom) {
+    startTiling(renderer, left, top, right, bottom);
+}
+
+void TileRenderer::startTileRendering(OpenGLRenderer* renderer,
+                                      const Rect* dirty, size_t count) {
+    int left = 0, top = 0, right = 0, bottom = 0;
+    bool found = false;
+
+    //glStartTilingQCOM takes a single region, so the dirty rects collapse
+    //into their bounding rect
+    for (size_t i = 0; dirty && i < count; i++) {
+        if (dirty[i].isEmpty())
+            continue;
+        int l = (int) floorf(dirty[i].left);
+        int t = (int) floorf(dirty[i].top);
+        int r = (int) ceilf(dirty[i].right);
+        int b = (int) ceilf(dirty[i].bottom);
+        if (!found) {
+            left = l; top = t; right = r; bottom = b;
+            found = true;
+        } else {
+            left = (l < left) ? l : left;
+            top = (t < top) ? t : top;
+            right = (r > right) ? r : right;
+            bottom = (b > bottom) ? b : bottom;
+        }
+    }
+
+    startTiling(renderer, left, top, right, bottom);
+}
+
+void TileRenderer::startTiling(OpenGLRenderer* renderer,
+                               int left, int top,
+                               int right, int bottom) {
     int width = 0;
     int height = 0;
-    GLenum status = GL_NO_ERROR;
+
+    if (mIsTiled) {
+        return;
+    }
 
     if (renderer != NULL) {
         renderer->getViewport(width, height);
@@ -70,7 +120,15 @@ void TileRenderer::startTileRendering(OpenGLRenderer* renderer,
         preserve = 1;
     }
 
-    //clear off all errors before tiling, if any
+    //Not worth a resolve/unresolve of the tile, render as usual
+    if (w <= 0 || h <= 0 || (w * h) < mMinTileArea) {
+        mTilesSkipped++;
+        return;
+    }
+
+    //clear off all errors before tiling, if any, so that the check below
+    //only sees what glStartTilingQCOM raised
+    GLenum status = GL_NO_ERROR;
     while ((status = glGetError()) != GL_NO_ERROR);
 
     if (preserve)
@@ -78,9 +136,17 @@ void TileRenderer::startTileRendering(OpenGLRenderer* renderer,
     else
         glStartTilingQCOM(l, t, w, h, GL_NONE);
 
+    //A failed start must not leak its error into HWUI's checks nor be
+    //followed by glEndTilingQCOM
     status = glGetError();
-    if (status == GL_NO_ERROR)
-        mIsTiled = true;
+    if (status != GL_NO_ERROR) {
+        ALOGE("%s: glStartTilingQCOM failed 0x%x", __FUNCTION__, status);
+        return;
+    }
+    if (preserve)
+        mTilesPreserved++;
+    mTilesStarted++;
+    mIsTiled = true;
 }
 
 void TileRenderer::endTileRendering(OpenGLRenderer*) {
@@ -89,8 +155,6 @@ void TileRenderer::endTileRendering(OpenGLRenderer*) {
     }
     glEndTilingQCOM(GL_COLOR_BUFFER_BIT0_QCOM);
     mIsTiled = false;
-    GLenum status = GL_NO_ERROR;
-    while ((status = glGetError()) != GL_NO_ERROR);
 }
 
 }; // namespace uirenderer
@@ -17,12 +17,15 @@
 #ifndef ANDROID_TILE_RENDERER_H
 #define ANDROID_TILE_RENDERER_H
 
+#include <stdint.h>
+#include <sys/types.h>
 #include <utils/Singleton.h>
 
 namespace android {
 namespace uirenderer {
 
 class OpenGLRenderer;
+class Rect;
 
 class TileRenderer: public Singleton<TileRenderer> {
     public:
@@ -30,10 +33,24 @@ class TileRenderer: public Singleton<TileRenderer> {
     ~TileRenderer();
 
     void startTileRendering(OpenGLRenderer* renderer, int left, int top, int right, int bottom);
+    // Tiles the bounding rect of the dirty rects, the whole viewport if
+    // there are none. Regions smaller than the threshold are not tiled.
+    void startTileRendering(OpenGLRenderer* renderer, const Rect* dirty, size_t count);
     void endTileRendering(OpenGLRenderer*);
 
+    uint32_t getTilesStarted() const { return mTilesStarted; }
+    uint32_t getTilesPreserved() const { return mTilesPreserved; }
+    uint32_t getTilesSkipped() const { return mTilesSkipped; }
+
     private:
+    void startTiling(OpenGLRenderer* renderer, int left, int top, int right, int bottom);
+
     bool mIsTiled;
+    // Regions under this many pixels are rendered without tiling
+    int mMinTileArea;
+    uint32_t mTilesStarted;
+    uint32_t mTilesPreserved;
+    uint32_t mTilesSkipped;
 };
 
 }; // namespace uirenderer